@@ -0,0 +1,143 @@
+/*
+ * gst-droid
+ *
+ * Copyright (C) 2015 Jolla LTD.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include "gstdroidbucketpool.h"
+
+/* 4KiB to 16MiB. Anything bigger gets allocated. */
+#define GST_DROID_BUCKET_POOL_MIN_SHIFT        12
+#define GST_DROID_BUCKET_POOL_BUCKETS          13
+
+struct _GstDroidBucketPool
+{
+  GMutex lock;
+  GstBufferPool *buckets[GST_DROID_BUCKET_POOL_BUCKETS];
+};
+
+static GstBufferPool *
+gst_droid_bucket_pool_create_bucket (gsize size)
+{
+  GstBufferPool *pool = gst_buffer_pool_new ();
+  GstStructure *config = gst_buffer_pool_get_config (pool);
+
+  gst_buffer_pool_config_set_params (config, NULL, size, 0, 0);
+
+  if (!gst_buffer_pool_set_config (pool, config)) {
+    GST_WARNING ("failed to configure buffer pool of size %" G_GSIZE_FORMAT,
+        size);
+    gst_object_unref (pool);
+    return NULL;
+  }
+
+  if (!gst_buffer_pool_set_active (pool, TRUE)) {
+    GST_WARNING ("failed to activate buffer pool of size %" G_GSIZE_FORMAT,
+        size);
+    gst_object_unref (pool);
+    return NULL;
+  }
+
+  return pool;
+}
+
+GstDroidBucketPool *
+gst_droid_bucket_pool_new (void)
+{
+  GstDroidBucketPool *pool = g_slice_new0 (GstDroidBucketPool);
+
+  g_mutex_init (&pool->lock);
+
+  return pool;
+}
+
+void
+gst_droid_bucket_pool_free (GstDroidBucketPool * pool)
+{
+  int x;
+
+  for (x = 0; x < GST_DROID_BUCKET_POOL_BUCKETS; x++) {
+    if (pool->buckets[x]) {
+      /* Buffers still in flight keep a reference to their pool */
+      gst_buffer_pool_set_active (pool->buckets[x], FALSE);
+      gst_object_unref (pool->buckets[x]);
+    }
+  }
+
+  g_mutex_clear (&pool->lock);
+
+  g_slice_free (GstDroidBucketPool, pool);
+}
+
+GstBuffer *
+gst_droid_bucket_pool_acquire (GstDroidBucketPool * pool, gsize size)
+{
+  int x;
+  GstBuffer *buffer = NULL;
+  GstBufferPool *bucket = NULL;
+
+  if (!pool) {
+    goto allocate;
+  }
+
+  for (x = 0; x < GST_DROID_BUCKET_POOL_BUCKETS; x++) {
+    if (size <= ((gsize) 1 << (GST_DROID_BUCKET_POOL_MIN_SHIFT + x))) {
+      break;
+    }
+  }
+
+  if (x == GST_DROID_BUCKET_POOL_BUCKETS) {
+    goto allocate;
+  }
+
+  g_mutex_lock (&pool->lock);
+
+  if (!pool->buckets[x]) {
+    pool->buckets[x] =
+        gst_droid_bucket_pool_create_bucket ((gsize) 1 <<
+        (GST_DROID_BUCKET_POOL_MIN_SHIFT + x));
+  }
+
+  if (pool->buckets[x]) {
+    bucket = gst_object_ref (pool->buckets[x]);
+  }
+
+  g_mutex_unlock (&pool->lock);
+
+  if (!bucket) {
+    goto allocate;
+  }
+
+  if (gst_buffer_pool_acquire_buffer (bucket, &buffer,
+          NULL) != GST_FLOW_OK) {
+    gst_object_unref (bucket);
+    goto allocate;
+  }
+
+  gst_object_unref (bucket);
+
+  /* The pool will restore the full size when the buffer gets released */
+  gst_buffer_resize (buffer, 0, size);
+
+  return buffer;
+
+allocate:
+  return gst_buffer_new_allocate (NULL, size, NULL);
+}
@@ -0,0 +1,44 @@
+/*
+ * gst-droid
+ *
+ * Copyright (C) 2015 Jolla LTD.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __GST_DROID_BUCKET_POOL_H__
+#define __GST_DROID_BUCKET_POOL_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GstDroidBucketPool GstDroidBucketPool;
+
+/*
+ * A set of buffer pools with power of 2 sized buffers.
+ * Used for variable sized data (encoder output) so we can recycle buffers
+ * instead of allocating a new one for each frame.
+ */
+GstDroidBucketPool *gst_droid_bucket_pool_new (void);
+void gst_droid_bucket_pool_free (GstDroidBucketPool * pool);
+
+/* pool can be NULL in which case a new buffer gets allocated.
+ * The returned buffer is exactly size bytes */
+GstBuffer *gst_droid_bucket_pool_acquire (GstDroidBucketPool * pool, gsize size);
+
+G_END_DECLS
+
+#endif /* __GST_DROID_BUCKET_POOL_H__ */
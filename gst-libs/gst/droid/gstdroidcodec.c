@@ -60,8 +60,8 @@ static gboolean is_mpega (GstDroidCodec * codec, const GstStructure * s);
 static gboolean is_h264_dec (GstDroidCodec * codec, const GstStructure * s);
 static gboolean is_h264_enc (GstDroidCodec * codec, const GstStructure * s);
 static void h264enc_complement (GstCaps * caps);
-static gboolean process_h264enc_data (DroidMediaData * in,
-    DroidMediaData * out);
+static GstBuffer *process_h264enc_data (DroidMediaData * in,
+    GstDroidBucketPool * pool);
 static void gst_droid_codec_release_input_frame (void *data);
 static void gst_droid_codec_free (GstDroidCodec * codec);
 static void gst_droid_codec_type_fill_quirks (GstDroidCodec * codec);
@@ -77,6 +77,44 @@ struct _GstDroidCodecPrivate
 {
   guint h264_nal;
   gboolean aac_adts;
+  gint profile;
+  gint level;
+};
+
+typedef struct
+{
+  const gchar *name;
+  gint value;
+} GstDroidCodecProfileLevel;
+
+/* Values are OMX_VIDEO_AVCPROFILETYPE and OMX_VIDEO_AVCLEVELTYPE */
+static GstDroidCodecProfileLevel h264_profiles[] = {
+  {"constrained-baseline", 0x1},
+  {"baseline", 0x1},
+  {"main", 0x2},
+  {"extended", 0x4},
+  {"high", 0x8},
+  {NULL, 0},
+};
+
+static GstDroidCodecProfileLevel h264_levels[] = {
+  {"1", 0x1},
+  {"1b", 0x2},
+  {"1.1", 0x4},
+  {"1.2", 0x8},
+  {"1.3", 0x10},
+  {"2", 0x20},
+  {"2.1", 0x40},
+  {"2.2", 0x80},
+  {"3", 0x100},
+  {"3.1", 0x200},
+  {"3.2", 0x400},
+  {"4", 0x800},
+  {"4.1", 0x1000},
+  {"4.2", 0x2000},
+  {"5", 0x4000},
+  {"5.1", 0x8000},
+  {NULL, 0},
 };
 
 struct _GstDroidCodecInfo
@@ -91,8 +129,8 @@ struct _GstDroidCodecInfo
       const GstStructure * s);
   void (*complement_caps) (GstCaps * caps);
   GstBuffer *(*create_encoder_codec_data) (DroidMediaData * data);
-    gboolean (*process_encoder_data) (DroidMediaData * in,
-      DroidMediaData * out);
+  GstBuffer *(*process_encoder_data) (DroidMediaData * in,
+      GstDroidBucketPool * pool);
     gboolean (*create_decoder_codec_data_from_codec_data) (GstDroidCodec *
       codec, GstBuffer * codec_data, DroidMediaData * out);
     gboolean (*create_decoder_codec_data_from_frame_data) (GstDroidCodec *
@@ -157,13 +195,23 @@ static GstDroidCodecInfo codecs[] = {
         CAPS_FRAGMENT_AUDIO_ENCODER, TRUE,
       is_mpeg4v, NULL, create_mpeg4venc_codec_data, NULL, NULL, NULL, NULL},
 
+  /* AMR carries no codec data. Caps are fixed by the codec itself.
+   * Not every device has an AMR encoder so enable it in gstdroidcodec.conf */
+  {GST_DROID_CODEC_ENCODER_AUDIO, "audio/AMR", "audio/3gpp",
+        "audio/AMR, rate=(int)8000, channels=(int)1", FALSE,
+      NULL, NULL, NULL, NULL, NULL, NULL, NULL},
+
+  {GST_DROID_CODEC_ENCODER_AUDIO, "audio/AMR-WB", "audio/amr-wb",
+        "audio/AMR-WB, rate=(int)16000, channels=(int)1", FALSE,
+      NULL, NULL, NULL, NULL, NULL, NULL, NULL},
+
   /* video encoders */
   {GST_DROID_CODEC_ENCODER_VIDEO, "video/mpeg", "video/mp4v-es",
         "video/mpeg, mpegversion=4, systemstream=false", TRUE,
       is_mpeg4v, NULL, create_mpeg4venc_codec_data, NULL, NULL, NULL, NULL},
 
   {GST_DROID_CODEC_ENCODER_VIDEO, "video/x-h264", "video/avc",
-        "video/x-h264, stream-format=avc,alignment=au", TRUE,
+        "video/x-h264, stream-format=avc,alignment=(string){au,nal}", TRUE,
         is_h264_enc, h264enc_complement, create_h264enc_codec_data,
       process_h264enc_data, NULL, NULL, NULL},
 };
@@ -290,6 +338,10 @@ GstBuffer *
 gst_droid_codec_create_encoder_codec_data (GstDroidCodec * codec,
     DroidMediaData * data)
 {
+  if (!codec->info->create_encoder_codec_data) {
+    return NULL;
+  }
+
   return codec->info->create_encoder_codec_data (data);
 }
 
@@ -356,19 +408,14 @@ gst_droid_codec_prepare_decoder_frame (GstDroidCodec * codec,
 
 GstBuffer *
 gst_droid_codec_prepare_encoded_data (GstDroidCodec * codec,
-    DroidMediaData * in)
+    DroidMediaData * in, GstDroidBucketPool * pool)
 {
   GstBuffer *buffer;
 
   if (codec->info->process_encoder_data) {
-    DroidMediaData out;
-    if (!codec->info->process_encoder_data (in, &out)) {
-      buffer = NULL;
-    } else {
-      buffer = gst_buffer_new_wrapped (out.data, out.size);
-    }
+    buffer = codec->info->process_encoder_data (in, pool);
   } else {
-    buffer = gst_buffer_new_allocate (NULL, in->size, NULL);
+    buffer = gst_droid_bucket_pool_acquire (pool, in->size);
     gst_buffer_fill (buffer, 0, in->data, in->size);
   }
 
@@ -398,6 +445,15 @@ gst_droid_codec_process_decoder_data (GstDroidCodec * codec, GstBuffer * buffer,
   return TRUE;
 }
 
+void
+gst_droid_codec_get_profile_level (GstDroidCodec * codec, gint * profile,
+    gint * level)
+{
+  /* 0 means we should leave it to the codec */
+  *profile = codec->data->profile;
+  *level = codec->data->level;
+}
+
 gint
 gst_droid_codec_get_samples_per_frane (GstCaps * caps)
 {
@@ -629,14 +685,30 @@ is_h264_dec (GstDroidCodec * codec G_GNUC_UNUSED, const GstStructure * s)
       && !g_strcmp0 (format, "avc");
 }
 
+static gint
+lookup_profile_level (GstDroidCodecProfileLevel * table, const gchar * name)
+{
+  int x;
+
+  for (x = 0; table[x].name; x++) {
+    if (!g_strcmp0 (table[x].name, name)) {
+      return table[x].value;
+    }
+  }
+
+  return 0;
+}
+
 static gboolean
-is_h264_enc (GstDroidCodec * codec G_GNUC_UNUSED, const GstStructure * s)
+is_h264_enc (GstDroidCodec * codec, const GstStructure * s)
 {
   const char *alignment = gst_structure_get_string (s, "alignment");
   const char *format = gst_structure_get_string (s, "stream-format");
+  const char *profile = gst_structure_get_string (s, "profile");
+  const char *level = gst_structure_get_string (s, "level");
 
   /* We can accept caps without alignment or format and will add them later on */
-  if (alignment && g_strcmp0 (alignment, "au")) {
+  if (alignment && g_strcmp0 (alignment, "au") && g_strcmp0 (alignment, "nal")) {
     return FALSE;
   }
 
@@ -644,14 +716,32 @@ is_h264_enc (GstDroidCodec * codec G_GNUC_UNUSED, const GstStructure * s)
     return FALSE;
   }
 
+  /* profile and level are optional. We cannot produce profiles we don't know about */
+  if (profile) {
+    codec->data->profile = lookup_profile_level (h264_profiles, profile);
+    if (!codec->data->profile) {
+      return FALSE;
+    }
+  }
+
+  if (level) {
+    codec->data->level = lookup_profile_level (h264_levels, level);
+  }
+
   return TRUE;
 }
 
 static void
 h264enc_complement (GstCaps * caps)
 {
-  gst_caps_set_simple (caps, "alignment", G_TYPE_STRING, "au",
-      "stream-format", G_TYPE_STRING, "avc", NULL);
+  GstStructure *s = gst_caps_get_structure (caps, 0);
+
+  /* nal alignment has to be requested explicitly */
+  if (g_strcmp0 (gst_structure_get_string (s, "alignment"), "nal")) {
+    gst_caps_set_simple (caps, "alignment", G_TYPE_STRING, "au", NULL);
+  }
+
+  gst_caps_set_simple (caps, "stream-format", G_TYPE_STRING, "avc", NULL);
 }
 
 static gboolean
@@ -1084,32 +1174,98 @@ process_aacdec_data (GstDroidCodec * codec, GstBuffer * buffer,
   return TRUE;
 }
 
-static gboolean
-process_h264enc_data (DroidMediaData * in, DroidMediaData * out)
+/* Returns the offset of the next start code at or after offset or size if none
+ * is found. sc_size will be set to the size of the start code */
+static gsize
+find_h264_start_code (const guint8 * data, gsize size, gsize offset,
+    gsize * sc_size)
 {
-  guint32 size;
-  guint8 *data;
+  while (offset + 3 <= size) {
+    if (data[offset + 2] > 1) {
+      /* can't be part of a start code */
+      offset += 3;
+    } else if (data[offset + 2] == 1 && data[offset + 1] == 0
+        && data[offset] == 0) {
+      if (offset > 0 && data[offset - 1] == 0) {
+        *sc_size = 4;
+        return offset - 1;
+      }
 
-  if (in->size >= 4 && memcmp (in->data, "\x00\x00\x00\x01", 4) == 0) {
-    /* We will replace the first 4 bytes with the NAL size */
-    out->size = in->size;
-    data = in->data + 4;
-  } else {
-    /* We don't have the NAL prefix so we add 4 bytes for the NAL size */
-    out->size = in->size + 4;
-    data = in->data;
+      *sc_size = 3;
+      return offset;
+    } else {
+      ++offset;
+    }
   }
 
-  size = GUINT32_TO_BE (out->size - 4);
-  out->data = g_malloc (out->size);
-  if (!out->data) {
-    return FALSE;
+  *sc_size = 0;
+  return size;
+}
+
+static GstBuffer *
+process_h264enc_data (DroidMediaData * in, GstDroidBucketPool * pool)
+{
+  /*
+   * Converts Annex B byte stream to AVC: each start code gets replaced
+   * by a 4 bytes NAL size. Data without a start code is a single NAL.
+   * We find out the output size first so the data can be copied only once
+   * into a buffer from the pool.
+   */
+  const guint8 *data = in->data;
+  gsize size = in->size;
+  gsize out_size = 0;
+  gsize offset, next, sc_size, next_sc_size;
+  GstBuffer *buffer;
+  GstMapInfo info;
+  guint8 *dst;
+
+  offset = find_h264_start_code (data, size, 0, &sc_size);
+  if (offset != 0) {
+    /* No start code at the beginning. Treat the leading bytes as a NAL */
+    offset = 0;
+    sc_size = 0;
+  }
+
+  /* first pass: calculate the size */
+  next = offset;
+  next_sc_size = sc_size;
+  while (next < size) {
+    gsize start = next + next_sc_size;
+    next = find_h264_start_code (data, size, start, &next_sc_size);
+    if (next > start) {
+      out_size += 4 + (next - start);
+    }
   }
 
-  memcpy (out->data, &size, sizeof (size));
-  memcpy (out->data + 4, data, out->size - 4);
+  if (out_size == 0) {
+    /* Nothing but start codes. Not an error, there is just no data */
+    return gst_buffer_new ();
+  }
 
-  return TRUE;
+  buffer = gst_droid_bucket_pool_acquire (pool, out_size);
+  if (!gst_buffer_map (buffer, &info, GST_MAP_WRITE)) {
+    gst_buffer_unref (buffer);
+    return NULL;
+  }
+
+  dst = info.data;
+
+  /* second pass: copy */
+  next = offset;
+  next_sc_size = sc_size;
+  while (next < size) {
+    gsize start = next + next_sc_size;
+    next = find_h264_start_code (data, size, start, &next_sc_size);
+    if (next > start) {
+      GST_WRITE_UINT32_BE (dst, next - start);
+      memcpy (dst + 4, data + start, next - start);
+      dst += 4 + (next - start);
+    }
+  }
+
+  gst_buffer_unmap (buffer, &info);
+
+  return buffer;
 }
 
 static void
@@ -1159,6 +1315,8 @@ gst_droid_codec_type_fill_quirks (GstDroidCodec * codec)
       codec->quirks |= USE_CODEC_SUPPLIED_WIDTH_VALUE;
     } else if (!g_strcmp0 (quirks_string[x], DONT_USE_DROID_CONVERT_NAME)) {
       codec->quirks |= DONT_USE_DROID_CONVERT_VALUE;
+    } else if (!g_strcmp0 (quirks_string[x], USE_PLANAR_INPUT_NAME)) {
+      codec->quirks |= USE_PLANAR_INPUT_VALUE;
     }
   }
 
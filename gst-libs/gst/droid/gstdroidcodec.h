@@ -25,6 +25,7 @@
 #include <gst/gst.h>
 #include <gst/video/video.h>
 #include "droidmediacodec.h"
+#include "gstdroidbucketpool.h"
 
 G_BEGIN_DECLS
 
@@ -38,6 +39,9 @@ G_BEGIN_DECLS
 #define DONT_USE_DROID_CONVERT_NAME    "dont-use-droid-convert"
 #define DONT_USE_DROID_CONVERT_VALUE   0x4
 
+#define USE_PLANAR_INPUT_NAME    "use-planar-input"
+#define USE_PLANAR_INPUT_VALUE   0x8
+
 typedef struct _GstDroidCodec GstDroidCodec;
 typedef struct _GstDroidCodecInfo GstDroidCodecInfo;
 typedef struct _GstDroidCodecPrivate GstDroidCodecPrivate;
@@ -98,11 +102,13 @@ gboolean gst_droid_codec_prepare_decoder_frame (GstDroidCodec * codec, GstVideoC
 						DroidMediaData * data,
 						DroidMediaBufferCallbacks *cb);
 
-GstBuffer *gst_droid_codec_prepare_encoded_data (GstDroidCodec * codec, DroidMediaData * in);
+GstBuffer *gst_droid_codec_prepare_encoded_data (GstDroidCodec * codec, DroidMediaData * in,
+						 GstDroidBucketPool * pool);
 
 gboolean gst_droid_codec_process_decoder_data (GstDroidCodec * codec, GstBuffer * buffer,
 					       DroidMediaData * out);
 gint gst_droid_codec_get_samples_per_frane (GstCaps * caps);
+void gst_droid_codec_get_profile_level (GstDroidCodec * codec, gint * profile, gint * level);
 
 G_END_DECLS
 
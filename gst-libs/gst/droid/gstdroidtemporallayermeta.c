@@ -0,0 +1,99 @@
+/*
+ * gst-droid
+ *
+ * Copyright (C) 2015 Jolla LTD.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include "gstdroidtemporallayermeta.h"
+
+static gboolean
+gst_droid_temporal_layer_meta_init (GstMeta * meta, gpointer params,
+    GstBuffer * buffer)
+{
+  GstDroidTemporalLayerMeta *m = (GstDroidTemporalLayerMeta *) meta;
+
+  m->layer_id = 0;
+  m->layer_count = 1;
+  m->ltr = FALSE;
+
+  return TRUE;
+}
+
+static gboolean
+gst_droid_temporal_layer_meta_transform (GstBuffer * dest, GstMeta * meta,
+    GstBuffer * buffer, GQuark type, gpointer data)
+{
+  GstDroidTemporalLayerMeta *m = (GstDroidTemporalLayerMeta *) meta;
+
+  if (GST_META_TRANSFORM_IS_COPY (type)) {
+    gst_buffer_add_droid_temporal_layer_meta (dest, m->layer_id,
+        m->layer_count, m->ltr);
+    return TRUE;
+  }
+
+  return FALSE;
+}
+
+GType
+gst_droid_temporal_layer_meta_api_get_type (void)
+{
+  static gsize type = 0;
+  static const gchar *tags[] = { NULL };
+
+  if (g_once_init_enter (&type)) {
+    GType _type =
+        gst_meta_api_type_register ("GstDroidTemporalLayerMetaAPI", tags);
+    g_once_init_leave (&type, _type);
+  }
+
+  return (GType) type;
+}
+
+const GstMetaInfo *
+gst_droid_temporal_layer_meta_get_info (void)
+{
+  static const GstMetaInfo *info = NULL;
+
+  if (g_once_init_enter (&info)) {
+    const GstMetaInfo *meta =
+        gst_meta_register (GST_DROID_TEMPORAL_LAYER_META_API_TYPE,
+        "GstDroidTemporalLayerMeta", sizeof (GstDroidTemporalLayerMeta),
+        gst_droid_temporal_layer_meta_init, NULL,
+        gst_droid_temporal_layer_meta_transform);
+    g_once_init_leave (&info, meta);
+  }
+
+  return info;
+}
+
+GstDroidTemporalLayerMeta *
+gst_buffer_add_droid_temporal_layer_meta (GstBuffer * buffer, guint layer_id,
+    guint layer_count, gboolean ltr)
+{
+  GstDroidTemporalLayerMeta *meta =
+      (GstDroidTemporalLayerMeta *) gst_buffer_add_meta (buffer,
+      GST_DROID_TEMPORAL_LAYER_META_INFO, NULL);
+
+  meta->layer_id = layer_id;
+  meta->layer_count = layer_count;
+  meta->ltr = ltr;
+
+  return meta;
+}
@@ -0,0 +1,60 @@
+/*
+ * gst-droid
+ *
+ * Copyright (C) 2015 Jolla LTD.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __GST_DROID_TEMPORAL_LAYER_META_H__
+#define __GST_DROID_TEMPORAL_LAYER_META_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+#define GST_DROID_TEMPORAL_LAYER_META_API_TYPE (gst_droid_temporal_layer_meta_api_get_type())
+#define GST_DROID_TEMPORAL_LAYER_META_INFO (gst_droid_temporal_layer_meta_get_info())
+
+typedef struct _GstDroidTemporalLayerMeta GstDroidTemporalLayerMeta;
+
+/*
+ * Attached to encoded buffers by droidvenc when temporal scalability is enabled.
+ * layer_id is the temporal layer of the frame (0 is the base layer).
+ * ltr is TRUE if the frame has been marked as a long term reference.
+ */
+struct _GstDroidTemporalLayerMeta
+{
+  GstMeta meta;
+
+  guint layer_id;
+  guint layer_count;
+  gboolean ltr;
+};
+
+GType gst_droid_temporal_layer_meta_api_get_type (void);
+const GstMetaInfo *gst_droid_temporal_layer_meta_get_info (void);
+
+#define gst_buffer_get_droid_temporal_layer_meta(b) \
+  ((GstDroidTemporalLayerMeta*)gst_buffer_get_meta((b),GST_DROID_TEMPORAL_LAYER_META_API_TYPE))
+
+GstDroidTemporalLayerMeta *gst_buffer_add_droid_temporal_layer_meta (GstBuffer * buffer,
+								      guint layer_id,
+								      guint layer_count,
+								      gboolean ltr);
+
+G_END_DECLS
+
+#endif /* __GST_DROID_TEMPORAL_LAYER_META_H__ */
@@ -0,0 +1,296 @@
+/*
+ * gst-droid
+ *
+ * Copyright (C) 2015 Jolla LTD.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include "gstdroidvideoupload.h"
+#include <string.h>
+
+#ifdef HAVE_ORC
+#include <orc/orc.h>
+#else
+#define orc_memcpy memcpy
+#endif
+
+#if defined (__ARM_NEON__) || defined (__ARM_NEON)
+#include <arm_neon.h>
+#define GST_DROID_VIDEO_UPLOAD_NEON
+#elif defined (__SSE2__)
+#include <emmintrin.h>
+#define GST_DROID_VIDEO_UPLOAD_SSE2
+#endif
+
+static void
+copy_plane (guint8 * dst, gsize dst_stride, const guint8 * src,
+    gsize src_stride, gsize width, gsize rows)
+{
+  gsize y;
+
+  if (dst_stride == src_stride) {
+    orc_memcpy (dst, (void *) src, src_stride * (rows - 1) + width);
+    return;
+  }
+
+  for (y = 0; y < rows; y++) {
+    orc_memcpy (dst + y * dst_stride, (void *) (src + y * src_stride), width);
+  }
+}
+
+static void
+interleave_row (guint8 * dst, const guint8 * u, const guint8 * v, gsize width)
+{
+  gsize x = 0;
+
+#if defined (GST_DROID_VIDEO_UPLOAD_NEON)
+  for (; x + 16 <= width; x += 16) {
+    uint8x16x2_t uv;
+    uv.val[0] = vld1q_u8 (u + x);
+    uv.val[1] = vld1q_u8 (v + x);
+    vst2q_u8 (dst + 2 * x, uv);
+  }
+#elif defined (GST_DROID_VIDEO_UPLOAD_SSE2)
+  for (; x + 16 <= width; x += 16) {
+    __m128i uu = _mm_loadu_si128 ((const __m128i *) (u + x));
+    __m128i vv = _mm_loadu_si128 ((const __m128i *) (v + x));
+    _mm_storeu_si128 ((__m128i *) (dst + 2 * x), _mm_unpacklo_epi8 (uu, vv));
+    _mm_storeu_si128 ((__m128i *) (dst + 2 * x + 16),
+        _mm_unpackhi_epi8 (uu, vv));
+  }
+#endif
+
+  for (; x < width; x++) {
+    dst[2 * x] = u[x];
+    dst[2 * x + 1] = v[x];
+  }
+}
+
+static void
+deinterleave_row (guint8 * u, guint8 * v, const guint8 * src, gsize width)
+{
+  gsize x = 0;
+
+#if defined (GST_DROID_VIDEO_UPLOAD_NEON)
+  for (; x + 16 <= width; x += 16) {
+    uint8x16x2_t uv = vld2q_u8 (src + 2 * x);
+    vst1q_u8 (u + x, uv.val[0]);
+    vst1q_u8 (v + x, uv.val[1]);
+  }
+#elif defined (GST_DROID_VIDEO_UPLOAD_SSE2)
+  {
+    const __m128i mask = _mm_set1_epi16 (0x00ff);
+    for (; x + 16 <= width; x += 16) {
+      __m128i a = _mm_loadu_si128 ((const __m128i *) (src + 2 * x));
+      __m128i b = _mm_loadu_si128 ((const __m128i *) (src + 2 * x + 16));
+      _mm_storeu_si128 ((__m128i *) (u + x),
+          _mm_packus_epi16 (_mm_and_si128 (a, mask), _mm_and_si128 (b,
+                  mask)));
+      _mm_storeu_si128 ((__m128i *) (v + x),
+          _mm_packus_epi16 (_mm_srli_epi16 (a, 8), _mm_srli_epi16 (b, 8)));
+    }
+  }
+#endif
+
+  for (; x < width; x++) {
+    u[x] = src[2 * x];
+    v[x] = src[2 * x + 1];
+  }
+}
+
+/* 16.16 fixed point bilinear. step is the distance between two samples */
+static void
+scale_plane (guint8 * dst, gsize dst_stride, gsize dst_step, gsize dst_width,
+    gsize dst_height, const guint8 * src, gsize src_stride, gsize src_step,
+    gsize src_width, gsize src_height)
+{
+  guint32 x_inc = (src_width << 16) / dst_width;
+  guint32 y_inc = (src_height << 16) / dst_height;
+  guint32 x_start = x_inc > 0x10000 ? (x_inc - 0x10000) / 2 : 0;
+  guint32 sy = y_inc > 0x10000 ? (y_inc - 0x10000) / 2 : 0;
+  gsize x, y;
+
+  for (y = 0; y < dst_height; y++) {
+    gsize y0 = MIN (sy >> 16, src_height - 1);
+    gsize y1 = MIN (y0 + 1, src_height - 1);
+    guint fy = (sy >> 8) & 0xff;
+    const guint8 *row0 = src + y0 * src_stride;
+    const guint8 *row1 = src + y1 * src_stride;
+    guint8 *out = dst + y * dst_stride;
+    guint32 sx = x_start;
+
+    for (x = 0; x < dst_width; x++) {
+      gsize x0 = MIN (sx >> 16, src_width - 1);
+      gsize x1 = MIN (x0 + 1, src_width - 1);
+      guint fx = (sx >> 8) & 0xff;
+      guint top = row0[x0 * src_step] * (256 - fx) + row0[x1 * src_step] * fx;
+      guint bottom =
+          row1[x0 * src_step] * (256 - fx) + row1[x1 * src_step] * fx;
+
+      out[x * dst_step] = (top * (256 - fy) + bottom * fy + 32768) >> 16;
+      sx += x_inc;
+    }
+
+    sy += y_inc;
+  }
+}
+
+gsize
+gst_droid_video_upload_get_size (GstVideoFormat format G_GNUC_UNUSED,
+    gsize stride, gsize slice_height)
+{
+  /* Both NV12 and I420 are 4:2:0 */
+  return stride * slice_height + (stride * slice_height) / 2;
+}
+
+gboolean
+gst_droid_video_upload (GstVideoFrame * src, guint8 * dst,
+    GstVideoFormat format, gsize stride, gsize slice_height)
+{
+  GstVideoFormat src_format = GST_VIDEO_FRAME_FORMAT (src);
+  gsize width = GST_VIDEO_FRAME_WIDTH (src);
+  gsize height = GST_VIDEO_FRAME_HEIGHT (src);
+  gsize cwidth = (width + 1) / 2;
+  gsize cheight = (height + 1) / 2;
+  guint8 *dst_uv = dst + stride * slice_height;
+  gsize y;
+
+  if (width > stride || height > slice_height) {
+    GST_ERROR ("frame %" G_GSIZE_FORMAT "x%" G_GSIZE_FORMAT
+        " does not fit %" G_GSIZE_FORMAT "x%" G_GSIZE_FORMAT, width, height,
+        stride, slice_height);
+    return FALSE;
+  }
+
+  /* luma is the same for all */
+  copy_plane (dst, stride, GST_VIDEO_FRAME_PLANE_DATA (src, 0),
+      GST_VIDEO_FRAME_PLANE_STRIDE (src, 0), width, height);
+
+  if (src_format == GST_VIDEO_FORMAT_NV12 && format == GST_VIDEO_FORMAT_NV12) {
+    copy_plane (dst_uv, stride, GST_VIDEO_FRAME_PLANE_DATA (src, 1),
+        GST_VIDEO_FRAME_PLANE_STRIDE (src, 1), cwidth * 2, cheight);
+  } else if (src_format == GST_VIDEO_FORMAT_I420
+      && format == GST_VIDEO_FORMAT_I420) {
+    guint8 *dst_v = dst_uv + (stride / 2) * (slice_height / 2);
+
+    copy_plane (dst_uv, stride / 2, GST_VIDEO_FRAME_PLANE_DATA (src, 1),
+        GST_VIDEO_FRAME_PLANE_STRIDE (src, 1), cwidth, cheight);
+    copy_plane (dst_v, stride / 2, GST_VIDEO_FRAME_PLANE_DATA (src, 2),
+        GST_VIDEO_FRAME_PLANE_STRIDE (src, 2), cwidth, cheight);
+  } else if (src_format == GST_VIDEO_FORMAT_I420
+      && format == GST_VIDEO_FORMAT_NV12) {
+    const guint8 *u = GST_VIDEO_FRAME_PLANE_DATA (src, 1);
+    const guint8 *v = GST_VIDEO_FRAME_PLANE_DATA (src, 2);
+    gsize u_stride = GST_VIDEO_FRAME_PLANE_STRIDE (src, 1);
+    gsize v_stride = GST_VIDEO_FRAME_PLANE_STRIDE (src, 2);
+
+    for (y = 0; y < cheight; y++) {
+      interleave_row (dst_uv + y * stride, u + y * u_stride, v + y * v_stride,
+          cwidth);
+    }
+  } else if (src_format == GST_VIDEO_FORMAT_NV12
+      && format == GST_VIDEO_FORMAT_I420) {
+    const guint8 *uv = GST_VIDEO_FRAME_PLANE_DATA (src, 1);
+    gsize uv_stride = GST_VIDEO_FRAME_PLANE_STRIDE (src, 1);
+    guint8 *dst_v = dst_uv + (stride / 2) * (slice_height / 2);
+
+    for (y = 0; y < cheight; y++) {
+      deinterleave_row (dst_uv + y * (stride / 2), dst_v + y * (stride / 2),
+          uv + y * uv_stride, cwidth);
+    }
+  } else {
+    GST_ERROR ("unsupported conversion from %s to %s",
+        gst_video_format_to_string (src_format),
+        gst_video_format_to_string (format));
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+gboolean
+gst_droid_video_upload_scaled (GstVideoFrame * src, guint8 * dst,
+    GstVideoFormat format, gsize width, gsize height, gsize stride,
+    gsize slice_height)
+{
+  GstVideoFormat src_format = GST_VIDEO_FRAME_FORMAT (src);
+  gsize src_width = GST_VIDEO_FRAME_WIDTH (src);
+  gsize src_height = GST_VIDEO_FRAME_HEIGHT (src);
+  const guint8 *src_u, *src_v;
+  gsize src_u_stride, src_v_stride, src_step;
+  guint8 *dst_u, *dst_v;
+  gsize dst_c_stride, dst_step;
+
+  if (width == src_width && height == src_height) {
+    return gst_droid_video_upload (src, dst, format, stride, slice_height);
+  }
+
+  if (width == 0 || height == 0 || width > stride || height > slice_height) {
+    GST_ERROR ("cannot scale to %" G_GSIZE_FORMAT "x%" G_GSIZE_FORMAT
+        " in %" G_GSIZE_FORMAT "x%" G_GSIZE_FORMAT, width, height, stride,
+        slice_height);
+    return FALSE;
+  }
+
+  if (src_format == GST_VIDEO_FORMAT_NV12) {
+    src_u = GST_VIDEO_FRAME_PLANE_DATA (src, 1);
+    src_v = src_u + 1;
+    src_u_stride = src_v_stride = GST_VIDEO_FRAME_PLANE_STRIDE (src, 1);
+    src_step = 2;
+  } else if (src_format == GST_VIDEO_FORMAT_I420) {
+    src_u = GST_VIDEO_FRAME_PLANE_DATA (src, 1);
+    src_v = GST_VIDEO_FRAME_PLANE_DATA (src, 2);
+    src_u_stride = GST_VIDEO_FRAME_PLANE_STRIDE (src, 1);
+    src_v_stride = GST_VIDEO_FRAME_PLANE_STRIDE (src, 2);
+    src_step = 1;
+  } else {
+    GST_ERROR ("unsupported source format %s",
+        gst_video_format_to_string (src_format));
+    return FALSE;
+  }
+
+  dst_u = dst + stride * slice_height;
+
+  if (format == GST_VIDEO_FORMAT_NV12) {
+    dst_v = dst_u + 1;
+    dst_c_stride = stride;
+    dst_step = 2;
+  } else if (format == GST_VIDEO_FORMAT_I420) {
+    dst_v = dst_u + (stride / 2) * (slice_height / 2);
+    dst_c_stride = stride / 2;
+    dst_step = 1;
+  } else {
+    GST_ERROR ("unsupported destination format %s",
+        gst_video_format_to_string (format));
+    return FALSE;
+  }
+
+  scale_plane (dst, stride, 1, width, height,
+      GST_VIDEO_FRAME_PLANE_DATA (src, 0), GST_VIDEO_FRAME_PLANE_STRIDE (src,
+          0), 1, src_width, src_height);
+
+  scale_plane (dst_u, dst_c_stride, dst_step, (width + 1) / 2,
+      (height + 1) / 2, src_u, src_u_stride, src_step, (src_width + 1) / 2,
+      (src_height + 1) / 2);
+  scale_plane (dst_v, dst_c_stride, dst_step, (width + 1) / 2,
+      (height + 1) / 2, src_v, src_v_stride, src_step, (src_width + 1) / 2,
+      (src_height + 1) / 2);
+
+  return TRUE;
+}
@@ -0,0 +1,52 @@
+/*
+ * gst-droid
+ *
+ * Copyright (C) 2015 Jolla LTD.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __GST_DROID_VIDEO_UPLOAD_H__
+#define __GST_DROID_VIDEO_UPLOAD_H__
+
+#include <gst/gst.h>
+#include <gst/video/video.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Copies I420 or NV12 system memory frames into the layout expected by
+ * android encoders: NV12 (semi planar) or I420 (planar) with the luma plane
+ * padded to stride x slice_height and the chroma plane(s) following it.
+ */
+gsize gst_droid_video_upload_get_size (GstVideoFormat format, gsize stride,
+				       gsize slice_height);
+
+gboolean gst_droid_video_upload (GstVideoFrame * src, guint8 * dst,
+				 GstVideoFormat format, gsize stride,
+				 gsize slice_height);
+
+/*
+ * Same as gst_droid_video_upload () but scales the frame to width x height
+ * on the way. Bilinear, meant for downscaling.
+ */
+gboolean gst_droid_video_upload_scaled (GstVideoFrame * src, guint8 * dst,
+					GstVideoFormat format, gsize width,
+					gsize height, gsize stride,
+					gsize slice_height);
+
+G_END_DECLS
+
+#endif /* __GST_DROID_VIDEO_UPLOAD_H__ */
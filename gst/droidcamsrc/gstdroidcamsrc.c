@@ -27,6 +27,7 @@
 #include "gstdroidcamsrc.h"
 #include "gstdroidcamsrcquirks.h"
 #include <gst/video/video.h>
+#include <gst/video/gstvideopool.h>
 #include "gst/droid/gstdroidmediabuffer.h"
 #include "gst/droid/gstdroidbufferpool.h"
 #include "gst/droid/gstwrappedmemory.h"
@@ -35,6 +36,7 @@
 #include "gstdroidcamsrcphotography.h"
 #include "gstdroidcamsrcrecorder.h"
 #include "droidmediacamera.h"
+#include <stdio.h>              /* sscanf() */
 #ifndef GST_USE_UNSTABLE_API
 #define GST_USE_UNSTABLE_API
 #endif /* GST_USE_UNSTABLE_API */
@@ -61,7 +63,8 @@ static GstStaticPadTemplate img_src_template_factory =
 GST_STATIC_PAD_TEMPLATE (GST_BASE_CAMERA_SRC_IMAGE_PAD_NAME,
     GST_PAD_SRC,
     GST_PAD_ALWAYS,
-    GST_STATIC_CAPS ("image/jpeg"));
+    GST_STATIC_CAPS ("image/jpeg; "
+        GST_VIDEO_CAPS_MAKE (GST_DROIDCAMSRC_ZSL_RING_FORMATS)));
 
 #if 0
 static GstStaticPadTemplate vid_src_template_factory =
@@ -92,7 +95,14 @@ static GstCaps *gst_droidcamsrc_pick_largest_resolution (GstDroidCamSrc * src,
 static gchar *gst_droidcamsrc_find_picture_resolution (GstDroidCamSrc * src,
     const gchar * resolution);
 static gboolean gst_droidcamsrc_is_zsl_and_hdr_supported (GstDroidCamSrc * src);
-static GstCaps *gst_droidcamsrc_get_video_caps_locked (GstDroidCamSrc * src);
+static GstCaps *gst_droidcamsrc_get_video_caps_locked (GstDroidCamSrc * src,
+    GstDroidCamSrcParams * params);
+static void gst_droidcamsrc_clear_info (GstDroidCamSrc * src);
+static GstStructure *gst_droidcamsrc_get_queue_stats (GstDroidCamSrc * src);
+static GstStructure *gst_droidcamsrc_get_capture_stats (GstDroidCamSrc * src);
+static GstStructure *gst_droidcamsrc_get_param_stats (GstDroidCamSrc * src);
+static gboolean gst_droidcamsrc_get_running_time (GstDroidCamSrc * src,
+    GstClockTime * ts);
 
 enum
 {
@@ -112,10 +122,21 @@ static guint droidcamsrc_signals[LAST_SIGNAL];
 #define DEFAULT_MIN_EV_COMPENSATION    -2.5f
 #define DEFAULT_MAX_EV_COMPENSATION    2.5f
 #define DEFAULT_FACE_DETECTION         FALSE
+#define DEFAULT_VIDEO_FACE_DETECTION   FALSE
 #define DEFAULT_IMAGE_NOISE_REDUCTION  TRUE
 #define DEFAULT_SENSOR_ORIENTATION     0
 #define DEFAULT_IMAGE_MODE             GST_DROIDCAMSRC_IMAGE_MODE_NORMAL
 #define DEFAULT_TARGET_BITRATE         12000000
+#define DEFAULT_VIEWFINDER_MAX_QUEUE_SIZE 4
+#define DEFAULT_VIDEO_MAX_QUEUE_SIZE   6
+#define DEFAULT_VIEWFINDER_LEAKY       GST_DROIDCAMSRC_LEAKY_DOWNSTREAM
+#define DEFAULT_VIDEO_LEAKY            GST_DROIDCAMSRC_LEAKY_NONE
+#define DEFAULT_BURST_COUNT            1
+#define DEFAULT_BURST_INTERVAL         0
+#define MAX_BURST_COUNT                100
+#define MAX_BURST_INTERVAL             10000    /* ms */
+#define DEFAULT_ZSL_RING_SIZE          0
+#define MAX_ZSL_RING_SIZE              4
 
 static GstDroidCamSrcPad *
 gst_droidcamsrc_create_pad (GstDroidCamSrc * src,
@@ -144,6 +165,11 @@ gst_droidcamsrc_create_pad (GstDroidCamSrc * src,
   pad->pushed_buffers = 0;
   pad->adjust_segment = FALSE;
   pad->pending_events = NULL;
+  /* unbounded unless configured otherwise */
+  pad->max_queue_size = 0;
+  pad->leaky = GST_DROIDCAMSRC_LEAKY_NONE;
+  pad->dropped_buffers = 0;
+  pad->high_water = 0;
   gst_segment_init (&pad->segment, GST_FORMAT_TIME);
 
   gst_element_add_pad (GST_ELEMENT (src), pad->pad);
@@ -161,19 +187,138 @@ gst_droidcamsrc_destroy_pad (GstDroidCamSrcPad * pad)
   g_slice_free (GstDroidCamSrcPad, pad);
 }
 
+/*
+ * Callbacks from the HAL must never block so when a pad queue is full we
+ * drop according to the leaky setting. Dropped buffers are released right
+ * away so the HAL gets its memory back. A non leaky pad is never limited
+ * and neither is a pad carrying an encoded stream because every frame there
+ * is needed to decode the ones after it.
+ */
+void
+gst_droidcamsrc_pad_queue_buffer (GstDroidCamSrcPad * pad, GstBuffer * buffer)
+{
+  GstBuffer *dropped = NULL;
+  guint len;
+
+  g_mutex_lock (&pad->lock);
+
+  len = g_queue_get_length (pad->queue);
+
+  if (!pad->encoded && pad->max_queue_size > 0
+      && len >= pad->max_queue_size) {
+    if (pad->leaky == GST_DROIDCAMSRC_LEAKY_UPSTREAM) {
+      dropped = buffer;
+      buffer = NULL;
+    } else if (pad->leaky == GST_DROIDCAMSRC_LEAKY_DOWNSTREAM) {
+      dropped = g_queue_pop_head (pad->queue);
+    }
+
+    if (dropped) {
+      ++pad->dropped_buffers;
+    }
+  }
+
+  if (buffer) {
+    g_queue_push_tail (pad->queue, buffer);
+    pad->high_water = MAX (pad->high_water, g_queue_get_length (pad->queue));
+    g_cond_signal (&pad->cond);
+  }
+
+  g_mutex_unlock (&pad->lock);
+
+  if (dropped) {
+    GST_LOG_OBJECT (pad->pad, "queue full, dropping buffer %p", dropped);
+    gst_buffer_unref (dropped);
+  }
+}
+
+static GstStructure *
+gst_droidcamsrc_get_queue_stats (GstDroidCamSrc * src)
+{
+  GstStructure *s = gst_structure_new_empty ("droidcamsrc-queue-stats");
+  GstDroidCamSrcPad *pads[] = { src->vfsrc, src->vidsrc, src->imgsrc };
+  guint x;
+
+  for (x = 0; x < G_N_ELEMENTS (pads); x++) {
+    gchar *dropped =
+        g_strdup_printf ("%s-dropped", GST_PAD_NAME (pads[x]->pad));
+    gchar *high_water =
+        g_strdup_printf ("%s-high-water", GST_PAD_NAME (pads[x]->pad));
+
+    g_mutex_lock (&pads[x]->lock);
+    gst_structure_set (s, dropped, G_TYPE_UINT64, pads[x]->dropped_buffers,
+        high_water, G_TYPE_UINT, pads[x]->high_water, NULL);
+    g_mutex_unlock (&pads[x]->lock);
+
+    g_free (dropped);
+    g_free (high_water);
+  }
+
+  return s;
+}
+
+static GstStructure *
+gst_droidcamsrc_get_capture_stats (GstDroidCamSrc * src)
+{
+  GstStructure *s;
+  GstDroidCamSrcCaptureStats *stats = &src->capture_stats;
+
+  g_mutex_lock (&src->capture_lock);
+  s = gst_structure_new ("droidcamsrc-capture-stats",
+      "shots", G_TYPE_UINT, stats->shots,
+      "shot-to-shot-last", G_TYPE_UINT64, stats->shot_to_shot_last,
+      "shot-to-shot-min", G_TYPE_UINT64, stats->shot_to_shot_min,
+      "shot-to-shot-max", G_TYPE_UINT64, stats->shot_to_shot_max,
+      "shot-to-shot-average", G_TYPE_UINT64, stats->shots > 1 ?
+      stats->shot_to_shot_total / (stats->shots - 1) : 0,
+      "capture-to-ready-last", G_TYPE_UINT64, stats->capture_to_ready_last,
+      "burst-taken", G_TYPE_UINT, stats->burst_taken,
+      "burst-dropped", G_TYPE_UINT, stats->burst_dropped,
+      "burst-fps", G_TYPE_DOUBLE, stats->burst_fps, NULL);
+  g_mutex_unlock (&src->capture_lock);
+
+  return s;
+}
+
+static GstStructure *
+gst_droidcamsrc_get_param_stats (GstDroidCamSrc * src)
+{
+  guint updates = 0, coalesced = 0, unchanged = 0;
+
+  g_rec_mutex_lock (&src->dev_lock);
+  if (src->dev) {
+    updates = src->dev->params_hal_updates;
+    coalesced = src->dev->params_coalesced;
+    unchanged = src->dev->params_unchanged;
+  }
+  g_rec_mutex_unlock (&src->dev_lock);
+
+  return gst_structure_new ("droidcamsrc-param-stats",
+      "hal-updates", G_TYPE_UINT, updates,
+      "coalesced", G_TYPE_UINT, coalesced,
+      "unchanged", G_TYPE_UINT, unchanged,
+      "saved", G_TYPE_UINT, coalesced + unchanged, NULL);
+}
+
 static void
 gst_droidcamsrc_init (GstDroidCamSrc * src)
 {
   src->quirks = gst_droidcamsrc_quirks_new ();
+  src->cache = gst_droidcamsrc_cache_new ();
   g_rec_mutex_init (&src->dev_lock);
   src->dev = NULL;
   src->camera_device = DEFAULT_CAMERA_DEVICE;
   src->mode = DEFAULT_MODE;
   src->captures = 0;
   g_mutex_init (&src->capture_lock);
+  g_cond_init (&src->burst_cond);
+  src->burst_count = DEFAULT_BURST_COUNT;
+  src->burst_interval = DEFAULT_BURST_INTERVAL;
+  src->zsl_ring_size = DEFAULT_ZSL_RING_SIZE;
   src->max_zoom = DEFAULT_MAX_ZOOM;
   src->video_torch = DEFAULT_VIDEO_TORCH;
   src->face_detection = DEFAULT_FACE_DETECTION;
+  src->video_face_detection = DEFAULT_VIDEO_FACE_DETECTION;
   src->image_noise_reduction = DEFAULT_IMAGE_NOISE_REDUCTION;
   src->image_mode = GST_DROIDCAMSRC_IMAGE_MODE_NORMAL;
   src->min_ev_compensation = DEFAULT_MIN_EV_COMPENSATION;
@@ -183,6 +328,8 @@ gst_droidcamsrc_init (GstDroidCamSrc * src)
   src->height = 0;
   src->fps_n = 0;
   src->fps_d = 1;
+  src->ts_offset = 0;
+  src->ts_offset_valid = FALSE;
   src->target_bitrate = DEFAULT_TARGET_BITRATE;
 
   gst_droidcamsrc_photography_init (src);
@@ -190,6 +337,8 @@ gst_droidcamsrc_init (GstDroidCamSrc * src)
   src->vfsrc = gst_droidcamsrc_create_pad (src,
       GST_BASE_CAMERA_SRC_VIEWFINDER_PAD_NAME, FALSE);
   src->vfsrc->negotiate = gst_droidcamsrc_vfsrc_negotiate;
+  src->vfsrc->max_queue_size = DEFAULT_VIEWFINDER_MAX_QUEUE_SIZE;
+  src->vfsrc->leaky = DEFAULT_VIEWFINDER_LEAKY;
 
   src->imgsrc = gst_droidcamsrc_create_pad (src,
       GST_BASE_CAMERA_SRC_IMAGE_PAD_NAME, TRUE);
@@ -199,6 +348,8 @@ gst_droidcamsrc_init (GstDroidCamSrc * src)
       GST_BASE_CAMERA_SRC_VIDEO_PAD_NAME, TRUE);
   src->vidsrc->adjust_segment = TRUE;
   src->vidsrc->negotiate = gst_droidcamsrc_vidsrc_negotiate;
+  src->vidsrc->max_queue_size = DEFAULT_VIDEO_MAX_QUEUE_SIZE;
+  src->vidsrc->leaky = DEFAULT_VIDEO_LEAKY;
 
   /* create the modes after we create the pads because the modes need the pads */
   src->image = gst_droidcamsrc_mode_new_image (src);
@@ -262,6 +413,10 @@ gst_droidcamsrc_get_property (GObject * object, guint prop_id, GValue * value,
       g_value_set_boolean (value, src->face_detection);
       break;
 
+    case PROP_VIDEO_FACE_DETECTION:
+      g_value_set_boolean (value, src->video_face_detection);
+      break;
+
     case PROP_IMAGE_NOISE_REDUCTION:
       g_value_set_boolean (value, src->image_noise_reduction);
       break;
@@ -302,6 +457,60 @@ gst_droidcamsrc_get_property (GObject * object, guint prop_id, GValue * value,
       g_value_set_int (value, src->target_bitrate);
       break;
 
+    case PROP_VIEWFINDER_MAX_QUEUE_SIZE:
+      g_mutex_lock (&src->vfsrc->lock);
+      g_value_set_uint (value, src->vfsrc->max_queue_size);
+      g_mutex_unlock (&src->vfsrc->lock);
+      break;
+
+    case PROP_VIEWFINDER_LEAKY:
+      g_mutex_lock (&src->vfsrc->lock);
+      g_value_set_enum (value, src->vfsrc->leaky);
+      g_mutex_unlock (&src->vfsrc->lock);
+      break;
+
+    case PROP_VIDEO_MAX_QUEUE_SIZE:
+      g_mutex_lock (&src->vidsrc->lock);
+      g_value_set_uint (value, src->vidsrc->max_queue_size);
+      g_mutex_unlock (&src->vidsrc->lock);
+      break;
+
+    case PROP_VIDEO_LEAKY:
+      g_mutex_lock (&src->vidsrc->lock);
+      g_value_set_enum (value, src->vidsrc->leaky);
+      g_mutex_unlock (&src->vidsrc->lock);
+      break;
+
+    case PROP_QUEUE_STATS:
+      g_value_take_boxed (value, gst_droidcamsrc_get_queue_stats (src));
+      break;
+
+    case PROP_CAPTURE_STATS:
+      g_value_take_boxed (value, gst_droidcamsrc_get_capture_stats (src));
+      break;
+
+    case PROP_PARAM_STATS:
+      g_value_take_boxed (value, gst_droidcamsrc_get_param_stats (src));
+      break;
+
+    case PROP_BURST_COUNT:
+      g_mutex_lock (&src->capture_lock);
+      g_value_set_uint (value, src->burst_count);
+      g_mutex_unlock (&src->capture_lock);
+      break;
+
+    case PROP_BURST_INTERVAL:
+      g_mutex_lock (&src->capture_lock);
+      g_value_set_uint (value, src->burst_interval);
+      g_mutex_unlock (&src->capture_lock);
+      break;
+
+    case PROP_ZSL_RING_SIZE:
+      GST_OBJECT_LOCK (src);
+      g_value_set_uint (value, src->zsl_ring_size);
+      GST_OBJECT_UNLOCK (src);
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -388,6 +597,11 @@ gst_droidcamsrc_set_property (GObject * object, guint prop_id,
       gst_droidcamsrc_apply_mode_settings (src, SET_AND_APPLY);
       break;
 
+    case PROP_VIDEO_FACE_DETECTION:
+      src->video_face_detection = g_value_get_boolean (value);
+      gst_droidcamsrc_apply_mode_settings (src, SET_AND_APPLY);
+      break;
+
     case PROP_IMAGE_NOISE_REDUCTION:
       src->image_noise_reduction = g_value_get_boolean (value);
       gst_droidcamsrc_apply_mode_settings (src, SET_AND_APPLY);
@@ -402,6 +616,52 @@ gst_droidcamsrc_set_property (GObject * object, guint prop_id,
       src->target_bitrate = g_value_get_int (value);
       break;
 
+    case PROP_VIEWFINDER_MAX_QUEUE_SIZE:
+      g_mutex_lock (&src->vfsrc->lock);
+      src->vfsrc->max_queue_size = g_value_get_uint (value);
+      g_mutex_unlock (&src->vfsrc->lock);
+      break;
+
+    case PROP_VIEWFINDER_LEAKY:
+      g_mutex_lock (&src->vfsrc->lock);
+      src->vfsrc->leaky = g_value_get_enum (value);
+      g_mutex_unlock (&src->vfsrc->lock);
+      break;
+
+    case PROP_VIDEO_MAX_QUEUE_SIZE:
+      g_mutex_lock (&src->vidsrc->lock);
+      src->vidsrc->max_queue_size = g_value_get_uint (value);
+      g_mutex_unlock (&src->vidsrc->lock);
+      break;
+
+    case PROP_VIDEO_LEAKY:
+      g_mutex_lock (&src->vidsrc->lock);
+      src->vidsrc->leaky = g_value_get_enum (value);
+      g_mutex_unlock (&src->vidsrc->lock);
+      break;
+
+    case PROP_BURST_COUNT:
+      /* takes effect with the next capture */
+      g_mutex_lock (&src->capture_lock);
+      src->burst_count = g_value_get_uint (value);
+      g_mutex_unlock (&src->capture_lock);
+      break;
+
+    case PROP_BURST_INTERVAL:
+      g_mutex_lock (&src->capture_lock);
+      src->burst_interval = g_value_get_uint (value);
+      g_mutex_unlock (&src->capture_lock);
+      break;
+
+    case PROP_ZSL_RING_SIZE:
+      GST_OBJECT_LOCK (src);
+      src->zsl_ring_size = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (src);
+
+      /* imgsrc caps depend on it */
+      gst_pad_mark_reconfigure (src->imgsrc->pad);
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -425,11 +685,15 @@ gst_droidcamsrc_finalize (GObject * object)
   gst_droidcamsrc_destroy_pad (src->vidsrc);
 
   g_mutex_clear (&src->capture_lock);
+  g_cond_clear (&src->burst_cond);
 
   gst_droidcamsrc_photography_destroy (src);
 
   gst_droidcamsrc_quirks_destroy (src->quirks);
 
+  gst_droidcamsrc_clear_info (src);
+  gst_droidcamsrc_cache_destroy (src->cache);
+
   g_rec_mutex_clear (&src->dev_lock);
 
   G_OBJECT_CLASS (parent_class)->finalize (object);
@@ -437,16 +701,23 @@ gst_droidcamsrc_finalize (GObject * object)
 
 static gboolean
 gst_droidcamsrc_fill_info (GstDroidCamSrc * src, GstDroidCamSrcCamInfo * target,
-    int facing)
+    int facing, int num)
 {
   DroidMediaCameraInfo info;
+  gchar *params;
   int x;
 
-  for (x = 0; x < MAX_CAMERAS; x++) {
-    if (droid_media_camera_get_info (&info, x) == false) {
+  for (x = 0; x < MIN (num, MAX_CAMERAS); x++) {
+    if (gst_droidcamsrc_cache_get_info (src->cache, x, &info.facing,
+            &info.orientation)) {
+      GST_DEBUG_OBJECT (src, "camera info for %d is cached", x);
+    } else if (droid_media_camera_get_info (&info, x) == false) {
       GST_WARNING_OBJECT (src, "Cannot get camera info for %d (facing %d)", x,
           facing);
       continue;
+    } else {
+      gst_droidcamsrc_cache_set_info (src->cache, x, info.facing,
+          info.orientation);
     }
 
     if (info.facing == facing) {
@@ -459,6 +730,16 @@ gst_droidcamsrc_fill_info (GstDroidCamSrc * src, GstDroidCamSrcCamInfo * target,
 
       GST_INFO_OBJECT (src, "camera %d is facing %d with orientation %d",
           target->num, target->direction, target->orientation);
+
+      /* lets caps queries be answered before the device is opened */
+      params =
+          gst_droidcamsrc_cache_get_params (src->cache, x,
+          &target->viewfinder_format);
+      if (params) {
+        target->params = gst_droidcamsrc_params_new (params);
+        g_free (params);
+      }
+
       return TRUE;
     }
   }
@@ -466,6 +747,23 @@ gst_droidcamsrc_fill_info (GstDroidCamSrc * src, GstDroidCamSrcCamInfo * target,
   return FALSE;
 }
 
+static void
+gst_droidcamsrc_clear_info (GstDroidCamSrc * src)
+{
+  int x;
+
+  g_rec_mutex_lock (&src->dev_lock);
+
+  for (x = 0; x < MAX_CAMERAS; x++) {
+    if (src->info[x].params) {
+      gst_droidcamsrc_params_destroy (src->info[x].params);
+      src->info[x].params = NULL;
+    }
+  }
+
+  g_rec_mutex_unlock (&src->dev_lock);
+}
+
 static gboolean
 gst_droidcamsrc_get_hw (GstDroidCamSrc * src)
 {
@@ -474,7 +772,14 @@ gst_droidcamsrc_get_hw (GstDroidCamSrc * src)
 
   GST_DEBUG_OBJECT (src, "get hw");
 
-  num = droid_media_camera_get_number_of_cameras ();
+  num = gst_droidcamsrc_cache_get_number_of_cameras (src->cache);
+  if (num < 0) {
+    num = droid_media_camera_get_number_of_cameras ();
+    if (num > 0) {
+      gst_droidcamsrc_cache_set_number_of_cameras (src->cache, num);
+    }
+  }
+
   GST_INFO_OBJECT (src, "Found %d cameras", num);
 
   if (num < 0) {
@@ -486,22 +791,30 @@ gst_droidcamsrc_get_hw (GstDroidCamSrc * src)
     GST_WARNING_OBJECT (src, "cannot support %d cameras", num);
   }
 
+  gst_droidcamsrc_clear_info (src);
+
+  g_rec_mutex_lock (&src->dev_lock);
+
   src->info[0].num = src->info[1].num = -1;
 
   back_found =
       gst_droidcamsrc_fill_info (src, &src->info[0],
-      DROID_MEDIA_CAMERA_FACING_BACK);
+      DROID_MEDIA_CAMERA_FACING_BACK, num);
   if (!back_found) {
     GST_WARNING_OBJECT (src, "cannot find back camera");
   }
 
   front_found =
       gst_droidcamsrc_fill_info (src, &src->info[1],
-      DROID_MEDIA_CAMERA_FACING_FRONT);
+      DROID_MEDIA_CAMERA_FACING_FRONT, num);
   if (!front_found) {
     GST_WARNING_OBJECT (src, "cannot find front camera");
   }
 
+  g_rec_mutex_unlock (&src->dev_lock);
+
+  gst_droidcamsrc_cache_save (src->cache);
+
   if (!front_found && !back_found) {
     GST_ERROR_OBJECT (src, "no cameras found");
     return FALSE;
@@ -531,6 +844,63 @@ gst_droidcamsrc_find_camera_device (GstDroidCamSrc * src)
   return NULL;
 }
 
+/* Now that the device is open, check what the cache told us against the HAL */
+static void
+gst_droidcamsrc_revalidate_cache (GstDroidCamSrc * src,
+    GstDroidCamSrcCamInfo * info)
+{
+  DroidMediaCameraInfo hal_info;
+  gchar *params;
+
+  g_rec_mutex_lock (&src->dev_lock);
+
+  if (droid_media_camera_get_info (&hal_info, info->num)) {
+    if (hal_info.orientation / 90 != info->orientation) {
+      GST_INFO_OBJECT (src, "cached orientation of camera %d is stale",
+          info->num);
+      info->orientation = hal_info.orientation / 90;
+    }
+
+    gst_droidcamsrc_cache_set_info (src->cache, info->num, hal_info.facing,
+        hal_info.orientation);
+  }
+
+  if (!src->dev->params) {
+    goto out;
+  }
+
+  if (info->params && info->viewfinder_format == src->dev->viewfinder_format
+      && gst_droidcamsrc_params_equal (info->params, src->dev->params)) {
+    GST_DEBUG_OBJECT (src, "cached parameters of camera %d are valid",
+        info->num);
+    goto out;
+  }
+
+  if (info->params) {
+    GST_INFO_OBJECT (src, "cached parameters of camera %d are stale",
+        info->num);
+    gst_droidcamsrc_params_destroy (info->params);
+
+    /* caps might have been negotiated from the stale parameters */
+    gst_pad_mark_reconfigure (src->vfsrc->pad);
+    gst_pad_mark_reconfigure (src->imgsrc->pad);
+    gst_pad_mark_reconfigure (src->vidsrc->pad);
+  }
+
+  /* the parameters are fresh from the HAL so this does not lose anything */
+  params = gst_droidcamsrc_params_to_string (src->dev->params);
+  gst_droidcamsrc_cache_set_params (src->cache, info->num, params,
+      src->dev->viewfinder_format);
+  info->params = gst_droidcamsrc_params_new (params);
+  info->viewfinder_format = src->dev->viewfinder_format;
+  g_free (params);
+
+out:
+  g_rec_mutex_unlock (&src->dev_lock);
+
+  gst_droidcamsrc_cache_save (src->cache);
+}
+
 static GstStateChangeReturn
 gst_droidcamsrc_change_state (GstElement * element, GstStateChange transition)
 {
@@ -588,6 +958,8 @@ gst_droidcamsrc_change_state (GstElement * element, GstStateChange transition)
         break;
       }
 
+      gst_droidcamsrc_revalidate_cache (src, info);
+
       if (quirk && quirk_is_property) {
         gst_droidcamsrc_quirks_apply_quirk (src->quirks, src,
             src->dev->info->direction, src->mode, quirk, TRUE);
@@ -613,6 +985,9 @@ gst_droidcamsrc_change_state (GstElement * element, GstStateChange transition)
       break;
 
     case GST_STATE_CHANGE_PAUSED_TO_PLAYING:
+      /* running time restarts from a new base time */
+      gst_droidcamsrc_timestamp_reset (src);
+
       /* set initial photography parameters */
       gst_droidcamsrc_photography_apply (src, SET_ONLY);
 
@@ -652,6 +1027,11 @@ gst_droidcamsrc_change_state (GstElement * element, GstStateChange transition)
   switch (transition) {
     case GST_STATE_CHANGE_PLAYING_TO_PAUSED:
       /* TODO: stop recording if we are recording */
+      g_mutex_lock (&src->capture_lock);
+      src->burst.cancelled = TRUE;
+      g_cond_signal (&src->burst_cond);
+      g_mutex_unlock (&src->capture_lock);
+
       gst_droidcamsrc_dev_stop (src->dev);
       src->captures = 0;
 
@@ -676,6 +1056,7 @@ gst_droidcamsrc_change_state (GstElement * element, GstStateChange transition)
     case GST_STATE_CHANGE_READY_TO_NULL:
       gst_droidcamsrc_dev_destroy (src->dev);
       src->dev = NULL;
+      gst_droidcamsrc_clear_info (src);
       break;
 
     default:
@@ -837,7 +1218,7 @@ gst_droidcamsrc_handle_roi_event (GstDroidCamSrc * src,
   g_ptr_array_free (focus_areas, TRUE);
   g_ptr_array_free (metering_areas, TRUE);
 
-  if (!gst_droidcamsrc_apply_params (src)) {
+  if (!gst_droidcamsrc_queue_params (src)) {
     GST_WARNING_OBJECT (src, "failed to apply parameters");
   }
 
@@ -1012,6 +1393,13 @@ gst_droidcamsrc_class_init (GstDroidCamSrcClass * klass)
           "Face detection", DEFAULT_FACE_DETECTION,
           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
+  g_object_class_install_property (gobject_class, PROP_VIDEO_FACE_DETECTION,
+      g_param_spec_boolean ("video-face-detection", "Video face detection",
+          "Keep face detection running in video mode. Detected faces are "
+          "attached to video frames as region of interest meta",
+          DEFAULT_VIDEO_FACE_DETECTION,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
   g_object_class_install_property (gobject_class, PROP_IMAGE_NOISE_REDUCTION,
       g_param_spec_boolean ("image-noise-reduction", "Image noise reduction",
           "Vendor specific image noise reduction",
@@ -1082,6 +1470,68 @@ gst_droidcamsrc_class_init (GstDroidCamSrcClass * klass)
           "Supported ISO speeds", G_VARIANT_TYPE_VARIANT, NULL,
           G_PARAM_READABLE));
 
+  g_object_class_install_property (gobject_class,
+      PROP_VIEWFINDER_MAX_QUEUE_SIZE,
+      g_param_spec_uint ("viewfinder-max-queue-size",
+          "Viewfinder max queue size",
+          "Maximum number of viewfinder buffers waiting to be pushed (0 = unlimited)",
+          0, G_MAXUINT, DEFAULT_VIEWFINDER_MAX_QUEUE_SIZE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_VIEWFINDER_LEAKY,
+      g_param_spec_enum ("viewfinder-leaky", "Viewfinder leaky",
+          "Which viewfinder buffers to drop when the queue is full",
+          GST_TYPE_DROIDCAMSRC_LEAKY, DEFAULT_VIEWFINDER_LEAKY,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_VIDEO_MAX_QUEUE_SIZE,
+      g_param_spec_uint ("video-max-queue-size", "Video max queue size",
+          "Maximum number of video buffers waiting to be pushed (0 = unlimited)",
+          0, G_MAXUINT, DEFAULT_VIDEO_MAX_QUEUE_SIZE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_VIDEO_LEAKY,
+      g_param_spec_enum ("video-leaky", "Video leaky",
+          "Which video buffers to drop when the queue is full. "
+          "Encoded streams are never dropped",
+          GST_TYPE_DROIDCAMSRC_LEAKY, DEFAULT_VIDEO_LEAKY,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_QUEUE_STATS,
+      g_param_spec_boxed ("queue-stats", "Queue statistics",
+          "Dropped buffers and queue high-water marks per pad",
+          GST_TYPE_STRUCTURE, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_CAPTURE_STATS,
+      g_param_spec_boxed ("capture-stats", "Capture statistics",
+          "Shot to shot and capture to ready-for-capture times (ns)",
+          GST_TYPE_STRUCTURE, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_PARAM_STATS,
+      g_param_spec_boxed ("param-stats", "Parameter statistics",
+          "Camera parameter updates sent to and saved from the HAL",
+          GST_TYPE_STRUCTURE, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_BURST_COUNT,
+      g_param_spec_uint ("burst-count", "Burst count",
+          "Number of images taken by one image capture",
+          1, MAX_BURST_COUNT, DEFAULT_BURST_COUNT,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_BURST_INTERVAL,
+      g_param_spec_uint ("burst-interval", "Burst interval",
+          "Minimum time between burst shots in ms (0 = as fast as possible)",
+          0, MAX_BURST_INTERVAL, DEFAULT_BURST_INTERVAL,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_ZSL_RING_SIZE,
+      g_param_spec_uint ("zsl-ring-size", "ZSL ring size",
+          "Number of viewfinder frames kept for zero shutter lag captures "
+          "pushed as raw video from imgsrc (0 = capture through the HAL). "
+          "Takes effect the next time image mode is negotiated",
+          0, MAX_ZSL_RING_SIZE, DEFAULT_ZSL_RING_SIZE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
   gst_droidcamsrc_photography_add_overrides (gobject_class);
 
   /* Signals */
@@ -1263,6 +1713,8 @@ gst_droidcamsrc_pad_activate_mode (GstPad * pad, GstObject * parent,
     data->open_stream = TRUE;
     data->open_segment = TRUE;
     data->pushed_buffers = 0;
+    data->dropped_buffers = 0;
+    data->high_water = 0;
     if (!gst_pad_start_task (pad, gst_droidcamsrc_loop, data, NULL)) {
       GST_ERROR_OBJECT (src, "failed to start pad task");
       return FALSE;
@@ -1286,6 +1738,10 @@ gst_droidcamsrc_pad_activate_mode (GstPad * pad, GstObject * parent,
     /* toss the queue */
     g_queue_foreach (data->queue, (GFunc) gst_buffer_unref, NULL);
     g_queue_clear (data->queue);
+
+    GST_INFO_OBJECT (src, "pad %s pushed %u buffers, dropped %" G_GUINT64_FORMAT
+        ", queue high-water mark %u", GST_PAD_NAME (pad), data->pushed_buffers,
+        data->dropped_buffers, data->high_water);
     g_mutex_unlock (&data->lock);
 
     GST_OBJECT_LOCK (src);
@@ -1394,6 +1850,9 @@ gst_droidcamsrc_pad_query (GstPad * pad, GstObject * parent, GstQuery * query)
   GstCaps *caps = NULL;
   GstCaps *filter = NULL;
   GstCaps *query_caps = NULL;
+  GstDroidCamSrcParams *params = NULL;
+  GstVideoFormat viewfinder_format = GST_VIDEO_FORMAT_UNKNOWN;
+  GstDroidCamSrcCamInfo *info;
 
   GST_DEBUG_OBJECT (src, "pad %s %" GST_PTR_FORMAT, GST_PAD_NAME (pad), query);
 
@@ -1452,18 +1911,44 @@ gst_droidcamsrc_pad_query (GstPad * pad, GstObject * parent, GstQuery * query)
 
 
     case GST_QUERY_CAPS:
-      /* if we have a device already, return the caps supported by HAL otherwise
-       * just return the pad template */
+      /* if we have a device already, return the caps supported by HAL. Before
+       * that the capability cache might know them. Otherwise just return the
+       * pad template */
       g_rec_mutex_lock (&src->dev_lock);
       if (src->dev && src->dev->params) {
+        params = src->dev->params;
+        viewfinder_format = src->dev->viewfinder_format;
+      } else if (src->dev) {
+        info = gst_droidcamsrc_find_camera_device (src);
+        if (info && info->params) {
+          params = info->params;
+          viewfinder_format = info->viewfinder_format;
+        }
+      }
+
+      if (params) {
         if (data == src->vfsrc) {
           caps =
-              gst_droidcamsrc_params_get_viewfinder_caps (src->dev->params,
-              src->dev->viewfinder_format);
+              gst_droidcamsrc_params_get_viewfinder_caps (params,
+              viewfinder_format);
         } else if (data == src->imgsrc) {
-          caps = gst_droidcamsrc_params_get_image_caps (src->dev->params);
+          GST_OBJECT_LOCK (src);
+          if (src->zsl_ring_size > 0) {
+            /* ring frames keep the viewfinder format */
+            if (gst_droidcamsrc_dev_zsl_ring_supports_format
+                (viewfinder_format)) {
+              caps = gst_caps_new_simple ("video/x-raw", "format",
+                  G_TYPE_STRING, gst_video_format_to_string (viewfinder_format),
+                  NULL);
+            } else {
+              caps = gst_caps_new_empty ();
+            }
+          } else {
+            caps = gst_droidcamsrc_params_get_image_caps (params);
+          }
+          GST_OBJECT_UNLOCK (src);
         } else if (data == src->vidsrc) {
-          caps = gst_droidcamsrc_get_video_caps_locked (src);
+          caps = gst_droidcamsrc_get_video_caps_locked (src, params);
         }
       } else {
         caps = gst_pad_get_pad_template_caps (data->pad);
@@ -1663,15 +2148,33 @@ gst_droidcamsrc_vfsrc_negotiate (GstDroidCamSrcPad * data)
         ret = FALSE;
       }
     }
+  } else {
+    /* Raw preview frames get copied out of the HAL callback. Keep a pool of
+     * frame sized buffers around so we do not allocate one per frame. */
+    GstStructure *config;
+
+    pool = gst_video_buffer_pool_new ();
+
+    config = gst_buffer_pool_get_config (pool);
+    gst_buffer_pool_config_set_params (config, our_caps, info.size, 2, 0);
+
+    if (!gst_buffer_pool_set_config (pool, config)) {
+      GST_ERROR_OBJECT (src, "Failed to set buffer pool configuration");
+      gst_object_unref (pool);
+      pool = NULL;
+    }
   }
 
   g_rec_mutex_lock (&src->dev_lock);
   src->dev->use_raw_data = use_raw_data;
 
+  /* the raw preview callback takes its reference under the pad lock */
+  g_mutex_lock (&src->vfsrc->lock);
   if (src->dev->pool) {
     gst_object_unref (src->dev->pool);
   }
   src->dev->pool = pool;
+  g_mutex_unlock (&src->vfsrc->lock);
 
   g_rec_mutex_unlock (&src->dev_lock);
 
@@ -1691,6 +2194,84 @@ out:
   return ret;
 }
 
+/* Captures come from the viewfinder so the size is only known when we
+ * push the first image. Agree on the format now. */
+static gboolean
+gst_droidcamsrc_imgsrc_negotiate_raw (GstDroidCamSrc * src,
+    GstDroidCamSrcPad * data)
+{
+  GstCaps *caps;
+  GstCaps *peer = NULL;
+  gboolean ret = FALSE;
+  GstVideoFormat format = src->dev->viewfinder_format;
+  GstVideoInfo info;
+  gint width, height;
+
+  /* ring frames are copied as they are, there is no conversion */
+  if (!gst_droidcamsrc_dev_zsl_ring_supports_format (format)) {
+    GST_ELEMENT_ERROR (src, STREAM, FORMAT,
+        ("viewfinder format %s cannot be used for ZSL ring capture",
+            gst_video_format_to_string (format)), (NULL));
+    goto out;
+  }
+
+  GST_OBJECT_LOCK (src);
+  width = src->width;
+  height = src->height;
+  GST_OBJECT_UNLOCK (src);
+
+  /* Images are viewfinder frames so they have its size. These are the same
+   * caps the capture itself sends */
+  if (width > 0 && height > 0) {
+    gst_video_info_set_format (&info, format, width, height);
+    caps = gst_video_info_to_caps (&info);
+  } else {
+    caps = gst_caps_new_simple ("video/x-raw", "format", G_TYPE_STRING,
+        gst_video_format_to_string (format), NULL);
+  }
+
+  peer = gst_pad_peer_query_caps (data->pad, caps);
+
+  GST_DEBUG_OBJECT (src, "peer caps %" GST_PTR_FORMAT, peer);
+
+  if (!peer || gst_caps_is_empty (peer)) {
+    GST_ELEMENT_ERROR (src, STREAM, FORMAT,
+        ("downstream does not accept %s images for ZSL ring capture",
+            gst_video_format_to_string (format)), (NULL));
+    gst_caps_unref (caps);
+    goto out;
+  }
+
+  if (width > 0 && height > 0) {
+    if (!gst_pad_set_caps (data->pad, caps)) {
+      GST_ERROR_OBJECT (src, "failed to set caps");
+      gst_caps_unref (caps);
+      goto out;
+    }
+
+    GST_DEBUG_OBJECT (src, "pad %s using caps %" GST_PTR_FORMAT,
+        GST_PAD_NAME (data->pad), caps);
+  } else {
+    /* the first capture sends them once the viewfinder knows its size */
+    GST_DEBUG_OBJECT (src, "no viewfinder size yet, not setting caps");
+  }
+
+  gst_caps_unref (caps);
+
+  GST_OBJECT_LOCK (src);
+  src->zsl_ring_active = TRUE;
+  GST_OBJECT_UNLOCK (src);
+
+  ret = TRUE;
+
+out:
+  if (peer) {
+    gst_caps_unref (peer);
+  }
+
+  return ret;
+}
+
 static gboolean
 gst_droidcamsrc_imgsrc_negotiate (GstDroidCamSrcPad * data)
 {
@@ -1705,6 +2286,15 @@ gst_droidcamsrc_imgsrc_negotiate (GstDroidCamSrcPad * data)
 
   GST_DEBUG_OBJECT (src, "imgsrc negotiate");
 
+  GST_OBJECT_LOCK (src);
+  src->zsl_ring_active = FALSE;
+  if (src->zsl_ring_size > 0) {
+    GST_OBJECT_UNLOCK (src);
+    ret = gst_droidcamsrc_imgsrc_negotiate_raw (src, data);
+    goto out;
+  }
+  GST_OBJECT_UNLOCK (src);
+
   our_caps = gst_droidcamsrc_params_get_image_caps (src->dev->params);
   GST_DEBUG_OBJECT (src, "our caps %" GST_PTR_FORMAT, our_caps);
 
@@ -1778,7 +2368,7 @@ gst_droidcamsrc_vidsrc_negotiate (GstDroidCamSrcPad * data)
 
   GST_DEBUG_OBJECT (src, "vidsrc negotiate");
 
-  our_caps = gst_droidcamsrc_get_video_caps_locked (src);
+  our_caps = gst_droidcamsrc_get_video_caps_locked (src, src->dev->params);
   GST_DEBUG_OBJECT (src, "our caps %" GST_PTR_FORMAT, our_caps);
 
   if (!our_caps || gst_caps_is_empty (our_caps)) {
@@ -1882,9 +2472,40 @@ gst_droidcamsrc_apply_params (GstDroidCamSrc * src)
   return ret;
 }
 
+gboolean
+gst_droidcamsrc_queue_params (GstDroidCamSrc * src)
+{
+  gboolean ret = FALSE;
+
+  GST_DEBUG_OBJECT (src, "queue params");
+
+  ret = gst_droidcamsrc_dev_queue_params (src->dev);
+
+  if (!ret) {
+    GST_ERROR_OBJECT (src, "failed to apply camera parameters");
+  }
+
+  return ret;
+}
+
 static gboolean
 gst_droidcamsrc_start_image_capture_locked (GstDroidCamSrc * src)
 {
+  GstClockTime shutter = GST_CLOCK_TIME_NONE;
+  gboolean zsl_ring;
+
+  GST_OBJECT_LOCK (src);
+  zsl_ring = src->zsl_ring_active;
+  GST_OBJECT_UNLOCK (src);
+
+  if (zsl_ring) {
+    GST_DEBUG_OBJECT (src, "start image capture from ZSL ring");
+
+    gst_droidcamsrc_get_running_time (src, &shutter);
+    gst_droidcamsrc_dev_capture_image_from_zsl_ring (src->dev, shutter);
+    return TRUE;
+  }
+
   GST_DEBUG_OBJECT (src, "start image capture");
 
   if (!gst_droidcamsrc_dev_capture_image (src->dev)) {
@@ -1979,6 +2600,38 @@ gst_droidcamsrc_start_capture (GstDroidCamSrc * src)
   g_mutex_lock (&src->capture_lock);
 
   if (src->mode == MODE_IMAGE) {
+    GstDroidCamSrcCaptureStats *stats = &src->capture_stats;
+    gint64 now = g_get_monotonic_time ();
+
+    if (stats->last_start > 0) {
+      GstClockTime interval = (now - stats->last_start) * GST_USECOND;
+
+      stats->shot_to_shot_last = interval;
+      stats->shot_to_shot_total += interval;
+      stats->shot_to_shot_max = MAX (stats->shot_to_shot_max, interval);
+      stats->shot_to_shot_min = stats->shot_to_shot_min == 0 ?
+          interval : MIN (stats->shot_to_shot_min, interval);
+
+      GST_INFO_OBJECT (src, "shot to shot time %" GST_TIME_FORMAT,
+          GST_TIME_ARGS (interval));
+    }
+
+    stats->last_start = now;
+    ++stats->shots;
+
+    src->burst.count = src->burst_count;
+    src->burst.interval = src->burst_interval;
+    src->burst.taken = 0;
+    src->burst.dropped = 0;
+    src->burst.cancelled = FALSE;
+    src->burst.start = now;
+    src->burst.next = now + src->burst.interval * G_TIME_SPAN_MILLISECOND;
+
+    if (src->burst.count > 1) {
+      GST_INFO_OBJECT (src, "starting burst of %u images, interval %u ms",
+          src->burst.count, src->burst.interval);
+    }
+
     started = gst_droidcamsrc_start_image_capture_locked (src);
   } else {
     started = gst_droidcamsrc_start_video_recording_locked (src);
@@ -2002,6 +2655,127 @@ out:
   GST_DEBUG_OBJECT (src, "started capture");
 }
 
+/* Called from the compressed image callback before the image is queued */
+void
+gst_droidcamsrc_image_shot_delivered (GstDroidCamSrc * src, GstBuffer * buffer)
+{
+  guint index, count;
+
+  g_mutex_lock (&src->capture_lock);
+  index = src->burst.taken;
+  count = src->burst.count;
+  g_mutex_unlock (&src->capture_lock);
+
+  if (count <= 1) {
+    return;
+  }
+
+  GST_BUFFER_OFFSET (buffer) = index;
+  GST_BUFFER_OFFSET_END (buffer) = count;
+
+  gst_droidcamsrc_post_message (src,
+      gst_structure_new (GST_DROIDCAMSRC_BURST_SHOT,
+          "index", G_TYPE_UINT, index,
+          "count", G_TYPE_UINT, count,
+          "timestamp", G_TYPE_UINT64, GST_BUFFER_PTS (buffer), NULL));
+}
+
+/* capture_lock must be held. Returns TRUE if another shot has been started */
+static gboolean
+gst_droidcamsrc_continue_burst_locked (GstDroidCamSrc * src)
+{
+  GstDroidCamSrcBurst *burst = &src->burst;
+
+  if (burst->taken + burst->dropped >= burst->count) {
+    return FALSE;
+  }
+
+  /* honor the interval but let stop-capture and state changes wake us up */
+  while (!burst->cancelled && g_get_monotonic_time () < burst->next) {
+    g_cond_wait_until (&src->burst_cond, &src->capture_lock, burst->next);
+  }
+
+  if (burst->cancelled || src->captures == 0) {
+    GST_INFO_OBJECT (src, "burst cancelled after %u images", burst->taken);
+    burst->dropped = burst->count - burst->taken;
+    return FALSE;
+  }
+
+  burst->next = MAX (burst->next + burst->interval * G_TIME_SPAN_MILLISECOND,
+      g_get_monotonic_time ());
+
+  if (!gst_droidcamsrc_start_image_capture_locked (src)) {
+    GST_WARNING_OBJECT (src, "failed to take burst image %u", burst->taken);
+    burst->dropped = burst->count - burst->taken;
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+/* Called once the HAL is able to take another picture */
+void
+gst_droidcamsrc_image_capture_done (GstDroidCamSrc * src, gboolean delivered)
+{
+  GstDroidCamSrcBurst *burst = &src->burst;
+  GstStructure *burst_done = NULL;
+
+  g_mutex_lock (&src->capture_lock);
+
+  if (delivered) {
+    ++burst->taken;
+  } else {
+    ++burst->dropped;
+  }
+
+  if (gst_droidcamsrc_continue_burst_locked (src)) {
+    g_mutex_unlock (&src->capture_lock);
+    return;
+  }
+
+  if (burst->count > 1) {
+    gint64 elapsed = g_get_monotonic_time () - burst->start;
+    gdouble fps = 0.0;
+
+    if (burst->taken > 1 && elapsed > 0) {
+      fps = (burst->taken - 1) * (gdouble) G_TIME_SPAN_SECOND / elapsed;
+    }
+
+    GST_INFO_OBJECT (src, "burst done: %u images, %u dropped, %.2f fps",
+        burst->taken, burst->dropped, fps);
+
+    src->capture_stats.burst_taken = burst->taken;
+    src->capture_stats.burst_dropped = burst->dropped;
+    src->capture_stats.burst_fps = fps;
+
+    burst_done = gst_structure_new (GST_DROIDCAMSRC_BURST_DONE,
+        "taken", G_TYPE_UINT, burst->taken,
+        "dropped", G_TYPE_UINT, burst->dropped,
+        "fps", G_TYPE_DOUBLE, fps, NULL);
+  }
+
+  /* a state change might have reset us already */
+  if (src->captures > 0) {
+    --src->captures;
+  }
+
+  if (src->capture_stats.last_start > 0) {
+    src->capture_stats.capture_to_ready_last =
+        (g_get_monotonic_time () - src->capture_stats.last_start) * GST_USECOND;
+
+    GST_INFO_OBJECT (src, "ready for capture after %" GST_TIME_FORMAT,
+        GST_TIME_ARGS (src->capture_stats.capture_to_ready_last));
+  }
+
+  g_mutex_unlock (&src->capture_lock);
+
+  if (burst_done) {
+    gst_droidcamsrc_post_message (src, burst_done);
+  }
+
+  g_object_notify (G_OBJECT (src), "ready-for-capture");
+}
+
 static void
 gst_droidcamsrc_stop_capture (GstDroidCamSrc * src)
 {
@@ -2021,6 +2795,10 @@ gst_droidcamsrc_stop_capture (GstDroidCamSrc * src)
   if (src->mode != MODE_IMAGE) {
     gst_droidcamsrc_stop_video_recording_locked (src);
     notify = TRUE;
+  } else {
+    /* the image in flight still gets delivered */
+    src->burst.cancelled = TRUE;
+    g_cond_signal (&src->burst_cond);
   }
 
 out:
@@ -2052,10 +2830,10 @@ gst_droidcamsrc_post_message (GstDroidCamSrc * src, GstStructure * s)
   }
 }
 
-void
-gst_droidcamsrc_timestamp (GstDroidCamSrc * src, GstBuffer * buffer)
+static gboolean
+gst_droidcamsrc_get_running_time (GstDroidCamSrc * src, GstClockTime * ts)
 {
-  GstClockTime base_time, ts;
+  GstClockTime base_time;
   GstClock *clock;
 
   GST_OBJECT_LOCK (src);
@@ -2069,13 +2847,46 @@ gst_droidcamsrc_timestamp (GstDroidCamSrc * src, GstBuffer * buffer)
 
   if (!clock) {
     GST_WARNING_OBJECT (src, "cannot timestamp without a clock");
-    return;
+    return FALSE;
   }
 
-  ts = gst_clock_get_time (clock) - base_time;
+  *ts = gst_clock_get_time (clock) - base_time;
 
   gst_object_unref (clock);
 
+  return TRUE;
+}
+
+/* caller must hold the object lock */
+static void
+gst_droidcamsrc_set_duration_locked (GstDroidCamSrc * src, GstBuffer * buffer)
+{
+  if (src->fps_n > 0 && src->fps_d > 0) {
+    GST_BUFFER_DURATION (buffer) =
+        gst_util_uint64_scale_int (GST_SECOND, src->fps_d, src->fps_n);
+  }
+}
+
+/* Forget the HAL time offset. The next frame measures it again instead of
+ * smoothing towards the new value and possibly going back in time */
+void
+gst_droidcamsrc_timestamp_reset (GstDroidCamSrc * src)
+{
+  GST_OBJECT_LOCK (src);
+  src->ts_offset = 0;
+  src->ts_offset_valid = FALSE;
+  GST_OBJECT_UNLOCK (src);
+}
+
+void
+gst_droidcamsrc_timestamp (GstDroidCamSrc * src, GstBuffer * buffer)
+{
+  GstClockTime ts;
+
+  if (!gst_droidcamsrc_get_running_time (src, &ts)) {
+    return;
+  }
+
   /* TODO: duration */
   GST_BUFFER_DTS (buffer) = ts;
   GST_BUFFER_PTS (buffer) = ts;
@@ -2085,6 +2896,70 @@ gst_droidcamsrc_timestamp (GstDroidCamSrc * src, GstBuffer * buffer)
       GST_TIME_ARGS (ts), buffer);
 }
 
+/*
+ * The HAL stamps frames with CLOCK_MONOTONIC when they leave the sensor.
+ * We sample the offset between that and the running time of the pipeline
+ * clock (which can be an audio clock) on every frame and follow it slowly
+ * so callback scheduling jitter does not end up in the timestamps while
+ * drift between the two clocks is still tracked.
+ */
+#define GST_DROIDCAMSRC_TS_OFFSET_SMOOTHING 16
+#define GST_DROIDCAMSRC_TS_OFFSET_RESYNC (200 * GST_MSECOND)
+
+void
+gst_droidcamsrc_timestamp_hal (GstDroidCamSrc * src, GstBuffer * buffer,
+    gint64 hal_ts)
+{
+  GstClockTime now;
+  GstClockTimeDiff sample, ts;
+
+  if (hal_ts <= 0) {
+    gst_droidcamsrc_timestamp (src, buffer);
+
+    GST_OBJECT_LOCK (src);
+    gst_droidcamsrc_set_duration_locked (src, buffer);
+    GST_OBJECT_UNLOCK (src);
+    return;
+  }
+
+  if (!gst_droidcamsrc_get_running_time (src, &now)) {
+    return;
+  }
+
+  sample = GST_CLOCK_DIFF (g_get_monotonic_time () * GST_USECOND, now);
+
+  GST_OBJECT_LOCK (src);
+
+  /* first frame or the running time jumped (pause, new base time) */
+  if (!src->ts_offset_valid
+      || ABS (sample - src->ts_offset) > GST_DROIDCAMSRC_TS_OFFSET_RESYNC) {
+    GST_DEBUG_OBJECT (src, "resyncing HAL time offset to %" G_GINT64_FORMAT,
+        sample);
+    src->ts_offset = sample;
+    src->ts_offset_valid = TRUE;
+  } else {
+    src->ts_offset +=
+        (sample - src->ts_offset) / GST_DROIDCAMSRC_TS_OFFSET_SMOOTHING;
+  }
+
+  ts = hal_ts + src->ts_offset;
+
+  gst_droidcamsrc_set_duration_locked (src, buffer);
+
+  GST_OBJECT_UNLOCK (src);
+
+  if (ts < 0) {
+    ts = 0;
+  }
+
+  GST_BUFFER_DTS (buffer) = ts;
+  GST_BUFFER_PTS (buffer) = ts;
+
+  GST_LOG_OBJECT (src,
+      "HAL timestamp %" G_GINT64_FORMAT " mapped to %" GST_TIME_FORMAT
+      " for buffer %" GST_PTR_FORMAT, hal_ts, GST_TIME_ARGS (ts), buffer);
+}
+
 void
 gst_droidcamsrc_update_max_zoom (GstDroidCamSrc * src)
 {
@@ -2169,8 +3044,10 @@ gst_droidcamsrc_apply_mode_settings (GstDroidCamSrc * src,
   /* face detection quirk */
   gst_droidcamsrc_apply_quirk (src, "face-detection", src->face_detection);
 
-  /* face detection */
-  if (src->mode == MODE_VIDEO || !src->face_detection) {
+  /* face detection. In video mode only if asked for. Detected faces then end
+   * up as region of interest meta on the video frames for the encoder */
+  if ((src->mode == MODE_VIDEO && !src->video_face_detection)
+      || !src->face_detection) {
     /* stop face detection */
     gst_droidcamsrc_dev_enable_face_detection (src->dev, FALSE);
   } else {
@@ -2191,7 +3068,7 @@ gst_droidcamsrc_apply_mode_settings (GstDroidCamSrc * src,
       (src->image_mode & GST_DROIDCAMSRC_IMAGE_MODE_HDR));
 
   if (type == SET_AND_APPLY) {
-    gst_droidcamsrc_apply_params (src);
+    gst_droidcamsrc_queue_params (src);
   }
 }
 
@@ -2360,33 +3237,18 @@ static gchar *
 gst_droidcamsrc_find_picture_resolution (GstDroidCamSrc * src,
     const gchar * resolution)
 {
-  const gchar *supported;
-  gchar **vals = NULL, **tmp;
+  gint width, height;
   gchar *ret = NULL;
 
   GST_DEBUG_OBJECT (src, "find picture resolution for %s", resolution);
 
-  supported =
-      gst_droidcamsrc_params_get_string (src->dev->params,
-      "picture-size-values");
-
-  GST_LOG_OBJECT (src, "supported picture sizes: %s", supported);
-
-  vals = g_strsplit (supported, ",", -1);
-
-  tmp = vals;
-  while (*tmp) {
-    if (!g_strcmp0 (*tmp, resolution)) {
-      GST_DEBUG_OBJECT (src, "found resolution %s", *tmp);
-      ret = g_strdup (*tmp);
-      goto out;
-    }
-    ++tmp;
+  if (sscanf (resolution, "%dx%d", &width, &height) == 2
+      && gst_droidcamsrc_params_has_picture_size (src->dev->params, width,
+          height)) {
+    GST_DEBUG_OBJECT (src, "found resolution %s", resolution);
+    ret = g_strdup (resolution);
   }
 
-out:
-  g_strfreev (vals);
-
   if (!ret) {
     GST_WARNING_OBJECT (src, "no picture resolution corresponding to %s",
         resolution);
@@ -2431,7 +3293,8 @@ out:
 }
 
 static GstCaps *
-gst_droidcamsrc_get_video_caps_locked (GstDroidCamSrc * src)
+gst_droidcamsrc_get_video_caps_locked (GstDroidCamSrc * src,
+    GstDroidCamSrcParams * params)
 {
   struct Data
   {
@@ -2460,7 +3323,7 @@ gst_droidcamsrc_get_video_caps_locked (GstDroidCamSrc * src)
     return TRUE;
   }
 
-  GstCaps *tpl = gst_droidcamsrc_params_get_video_caps (src->dev->params);
+  GstCaps *tpl = gst_droidcamsrc_params_get_video_caps (params);
   GstCaps *caps = gst_caps_new_empty ();
   GstCaps *encoded =
       gst_droid_codec_get_all_caps (GST_DROID_CODEC_ENCODER_VIDEO);
@@ -26,6 +26,7 @@
 #include "gstdroidcamsrcdev.h"
 #include "gstdroidcamsrcenums.h"
 #include "gstdroidcamsrcquirks.h"
+#include "gstdroidcamsrccache.h"
 #include <gst/meta/nemometa.h>
 #ifndef GST_USE_UNSTABLE_API
 #define GST_USE_UNSTABLE_API
@@ -51,6 +52,9 @@ G_BEGIN_DECLS
 #define MAX_CAMERAS 2
 #define GST_DROIDCAMSRC_CAPTURE_START "photo-capture-start"
 #define GST_DROIDCAMSRC_CAPTURE_END "photo-capture-end"
+#define GST_DROIDCAMSRC_BURST_SHOT "burst-shot"
+#define GST_DROIDCAMSRC_BURST_DONE "burst-done"
+#define GST_DROIDCAMSRC_ZSL_RING_FORMATS "{ NV21, NV12, YV12 }"
 #define GST_DROIDCAMSRC_PREVIEW_IMAGE "photo-capture-preview"
 
 typedef struct _GstDroidCamSrc GstDroidCamSrc;
@@ -58,6 +62,8 @@ typedef struct _GstDroidCamSrcClass GstDroidCamSrcClass;
 typedef struct _GstDroidCamSrcCamInfo GstDroidCamSrcCamInfo;
 typedef struct _GstDroidCamSrcPad GstDroidCamSrcPad;
 typedef struct _GstDroidCamSrcPhotography GstDroidCamSrcPhotography;
+typedef struct _GstDroidCamSrcCaptureStats GstDroidCamSrcCaptureStats;
+typedef struct _GstDroidCamSrcBurst GstDroidCamSrcBurst;
 typedef enum _GstDroidCamSrcApplyType GstDroidCamSrcApplyType;
 
 typedef gboolean (* GstDroidCamSrcNegotiateCallback)(GstDroidCamSrcPad * pad);
@@ -67,6 +73,10 @@ struct _GstDroidCamSrcCamInfo
   int num;
   NemoGstDeviceDirection direction;
   NemoGstBufferOrientation orientation;
+
+  /* from the capability cache, until the device is open. protected by dev_lock */
+  GstDroidCamSrcParams *params;
+  GstVideoFormat viewfinder_format;
 };
 
 struct _GstDroidCamSrcPad
@@ -84,6 +94,40 @@ struct _GstDroidCamSrcPad
   GstSegment segment;
   GstDroidCamSrcNegotiateCallback negotiate;
   GList *pending_events;
+
+  /* queue limits and accounting. protected by lock */
+  guint max_queue_size;
+  GstDroidCamSrcLeaky leaky;
+  gboolean encoded;
+  guint64 dropped_buffers;
+  guint high_water;
+};
+
+/* All times are in nanoseconds */
+struct _GstDroidCamSrcCaptureStats
+{
+  guint shots;
+  gint64 last_start;            /* monotonic time, usec */
+  GstClockTime shot_to_shot_last;
+  GstClockTime shot_to_shot_min;
+  GstClockTime shot_to_shot_max;
+  GstClockTime shot_to_shot_total;
+  GstClockTime capture_to_ready_last;
+  /* last burst */
+  guint burst_taken;
+  guint burst_dropped;
+  gdouble burst_fps;
+};
+
+struct _GstDroidCamSrcBurst
+{
+  guint count;                  /* shots requested */
+  guint taken;                  /* shots delivered */
+  guint dropped;
+  guint interval;               /* ms */
+  gint64 start;                 /* monotonic time, usec */
+  gint64 next;                  /* monotonic time, usec */
+  gboolean cancelled;
 };
 
 struct _GstDroidCamSrc
@@ -91,6 +135,7 @@ struct _GstDroidCamSrc
   GstElement parent;
 
   GstDroidCamSrcQuirks *quirks;
+  GstDroidCamSrcCache *cache;
   GstDroidCamSrcDev *dev;
   GRecMutex dev_lock;
   GstDroidCamSrcCamInfo info[MAX_CAMERAS];
@@ -108,9 +153,16 @@ struct _GstDroidCamSrc
 
   int captures;
   GMutex capture_lock;
+  /* protected by capture_lock */
+  GstDroidCamSrcCaptureStats capture_stats;
+  GstDroidCamSrcBurst burst;
+  GCond burst_cond;
+  guint burst_count;
+  guint burst_interval;
 
   gboolean video_torch;
   gboolean face_detection;
+  gboolean video_face_detection;
   gboolean image_noise_reduction;
   GstDroidCamSrcImageMode image_mode;
 
@@ -127,6 +179,12 @@ struct _GstDroidCamSrc
   gint height;
   gint fps_n, fps_d;
   DroidMediaRect crop_rect;
+  /* HAL monotonic time to running time */
+  GstClockTimeDiff ts_offset;
+  gboolean ts_offset_valid;
+  /* in-element ZSL, active when imgsrc got raw caps */
+  guint zsl_ring_size;
+  gboolean zsl_ring_active;
 };
 
 struct _GstDroidCamSrcClass
@@ -143,9 +201,15 @@ enum _GstDroidCamSrcApplyType
 GType gst_droidcamsrc_get_type (void);
 void gst_droidcamsrc_post_message (GstDroidCamSrc * src, GstStructure * s);
 void gst_droidcamsrc_timestamp (GstDroidCamSrc * src, GstBuffer * buffer);
+void gst_droidcamsrc_timestamp_hal (GstDroidCamSrc * src, GstBuffer * buffer, gint64 hal_ts);
+void gst_droidcamsrc_timestamp_reset (GstDroidCamSrc * src);
 gboolean gst_droidcamsrc_apply_params (GstDroidCamSrc * src);
+gboolean gst_droidcamsrc_queue_params (GstDroidCamSrc * src);
 void gst_droidcamsrc_apply_mode_settings (GstDroidCamSrc * src, GstDroidCamSrcApplyType type);
 void gst_droidcamsrc_update_max_zoom (GstDroidCamSrc * src);
+void gst_droidcamsrc_pad_queue_buffer (GstDroidCamSrcPad * pad, GstBuffer * buffer);
+void gst_droidcamsrc_image_capture_done (GstDroidCamSrc * src, gboolean delivered);
+void gst_droidcamsrc_image_shot_delivered (GstDroidCamSrc * src, GstBuffer * buffer);
 
 G_END_DECLS
 
@@ -0,0 +1,401 @@
+/*
+ * gst-droid
+ *
+ * Copyright (C) 2014 Mohammed Sameer <msameer@foolab.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <gst/gst.h>
+#include <string.h>
+#include "gstdroidcamsrccache.h"
+
+/*
+ * The capability cache keeps what we learned from the HAL about each camera
+ * so that the next start up can answer caps queries without opening the
+ * device first. Everything is thrown away once the firmware changes.
+ *
+ * The cache is read from $XDG_CACHE_HOME/gst-droid/gstdroidcamsrccache.conf
+ * and, if that is missing or stale, from
+ * $(sysconfdir)/gst-droid/gstdroidcamsrccache.conf which a system image can
+ * ship pre-populated. It is only ever written to the former.
+ *
+ * Format:
+ * [device]
+ * fingerprint=<build fingerprints from build.prop>
+ * cameras=<number of cameras>
+ *
+ * [camera-<camera id>]
+ * facing=<DroidMediaCameraInfo facing>
+ * orientation=<DroidMediaCameraInfo orientation in degrees>
+ * viewfinder-format=<GstVideoFormat name>
+ * params=<CameraParameters as returned by the HAL>
+ *
+ * The cache is not thread safe. droidcamsrc only touches it from
+ * state changes.
+ */
+
+GST_DEBUG_CATEGORY_EXTERN (gst_droid_camsrc_debug);
+#define GST_CAT_DEFAULT gst_droid_camsrc_debug
+
+#define DEVICE_GROUP "device"
+
+struct _GstDroidCamSrcCache
+{
+  GKeyFile *file;
+  gchar *path;
+  gchar *fingerprint;
+  gboolean dirty;
+};
+
+static const gchar *build_props[] = {
+  "/system/build.prop",
+  "/vendor/build.prop",
+  NULL
+};
+
+static gchar *
+gst_droidcamsrc_cache_read_fingerprint (void)
+{
+  GString *fingerprint = g_string_new (NULL);
+  int x;
+
+  for (x = 0; build_props[x]; x++) {
+    gchar *contents = NULL;
+    gchar **lines, **line;
+
+    if (!g_file_get_contents (build_props[x], &contents, NULL, NULL)) {
+      continue;
+    }
+
+    lines = g_strsplit (contents, "\n", -1);
+
+    for (line = lines; *line; line++) {
+      /* ro.build.fingerprint, ro.vendor.build.fingerprint, ... */
+      if (g_str_has_prefix (*line, "ro.")
+          && strstr (*line, "build.fingerprint=")) {
+        if (fingerprint->len > 0) {
+          g_string_append_c (fingerprint, '|');
+        }
+
+        g_string_append (fingerprint, g_strstrip (strchr (*line, '=') + 1));
+      }
+    }
+
+    g_strfreev (lines);
+    g_free (contents);
+  }
+
+  if (fingerprint->len == 0) {
+    g_string_free (fingerprint, TRUE);
+    return NULL;
+  }
+
+  return g_string_free (fingerprint, FALSE);
+}
+
+static void
+gst_droidcamsrc_cache_reset (GstDroidCamSrcCache * cache)
+{
+  if (cache->file) {
+    g_key_file_unref (cache->file);
+  }
+
+  cache->file = g_key_file_new ();
+
+  if (cache->fingerprint) {
+    g_key_file_set_string (cache->file, DEVICE_GROUP, "fingerprint",
+        cache->fingerprint);
+  }
+}
+
+static gboolean
+gst_droidcamsrc_cache_load (GstDroidCamSrcCache * cache, const gchar * path)
+{
+  GError *err = NULL;
+  gchar *fingerprint;
+  gboolean ret;
+
+  if (!g_key_file_load_from_file (cache->file, path, G_KEY_FILE_NONE, &err)) {
+    GST_DEBUG ("failed to load capability cache %s: %s", path, err->message);
+    g_error_free (err);
+    gst_droidcamsrc_cache_reset (cache);
+    return FALSE;
+  }
+
+  fingerprint =
+      g_key_file_get_string (cache->file, DEVICE_GROUP, "fingerprint", NULL);
+  ret = g_strcmp0 (fingerprint, cache->fingerprint) == 0;
+  g_free (fingerprint);
+
+  if (!ret) {
+    GST_INFO ("capability cache %s was made for a different firmware", path);
+    gst_droidcamsrc_cache_reset (cache);
+  }
+
+  return ret;
+}
+
+GstDroidCamSrcCache *
+gst_droidcamsrc_cache_new ()
+{
+  GstDroidCamSrcCache *cache = g_slice_new0 (GstDroidCamSrcCache);
+  gchar *seed;
+
+  cache->path = g_build_filename (g_get_user_cache_dir (), "gst-droid",
+      "gstdroidcamsrccache.conf", NULL);
+  cache->fingerprint = gst_droidcamsrc_cache_read_fingerprint ();
+
+  gst_droidcamsrc_cache_reset (cache);
+
+  if (!cache->fingerprint) {
+    GST_WARNING ("cannot find firmware fingerprint, capability cache disabled");
+    return cache;
+  }
+
+  if (gst_droidcamsrc_cache_load (cache, cache->path)) {
+    GST_INFO ("loaded capability cache %s", cache->path);
+    return cache;
+  }
+
+  seed =
+      g_build_path ("/", SYSCONFDIR, "gst-droid/gstdroidcamsrccache.conf",
+      NULL);
+
+  if (gst_droidcamsrc_cache_load (cache, seed)) {
+    GST_INFO ("loaded capability cache %s", seed);
+  }
+
+  g_free (seed);
+
+  return cache;
+}
+
+void
+gst_droidcamsrc_cache_destroy (GstDroidCamSrcCache * cache)
+{
+  g_key_file_unref (cache->file);
+  g_free (cache->path);
+  g_free (cache->fingerprint);
+  g_slice_free (GstDroidCamSrcCache, cache);
+}
+
+void
+gst_droidcamsrc_cache_save (GstDroidCamSrcCache * cache)
+{
+  GError *err = NULL;
+  gchar *dir;
+  gchar *data;
+  gsize len;
+
+  if (!cache->fingerprint || !cache->dirty) {
+    return;
+  }
+
+  cache->dirty = FALSE;
+
+  dir = g_path_get_dirname (cache->path);
+
+  if (g_mkdir_with_parents (dir, 0700) != 0) {
+    GST_WARNING ("failed to create %s", dir);
+    goto out;
+  }
+
+  data = g_key_file_to_data (cache->file, &len, NULL);
+
+  if (!g_file_set_contents (cache->path, data, len, &err)) {
+    GST_WARNING ("failed to save capability cache %s: %s", cache->path,
+        err->message);
+    g_error_free (err);
+  } else {
+    GST_INFO ("saved capability cache %s", cache->path);
+  }
+
+  g_free (data);
+
+out:
+  g_free (dir);
+}
+
+static gchar *
+gst_droidcamsrc_cache_group (gint num)
+{
+  return g_strdup_printf ("camera-%d", num);
+}
+
+static void
+gst_droidcamsrc_cache_set_integer (GstDroidCamSrcCache * cache,
+    const gchar * group, const gchar * key, gint value)
+{
+  GError *err = NULL;
+  gint old = g_key_file_get_integer (cache->file, group, key, &err);
+
+  if (!err && old == value) {
+    return;
+  }
+
+  g_clear_error (&err);
+
+  g_key_file_set_integer (cache->file, group, key, value);
+  cache->dirty = TRUE;
+}
+
+static void
+gst_droidcamsrc_cache_set_string (GstDroidCamSrcCache * cache,
+    const gchar * group, const gchar * key, const gchar * value)
+{
+  gchar *old = g_key_file_get_string (cache->file, group, key, NULL);
+
+  if (g_strcmp0 (old, value) != 0) {
+    g_key_file_set_string (cache->file, group, key, value);
+    cache->dirty = TRUE;
+  }
+
+  g_free (old);
+}
+
+gint
+gst_droidcamsrc_cache_get_number_of_cameras (GstDroidCamSrcCache * cache)
+{
+  GError *err = NULL;
+  gint num;
+
+  if (!cache->fingerprint) {
+    return -1;
+  }
+
+  num = g_key_file_get_integer (cache->file, DEVICE_GROUP, "cameras", &err);
+  if (err) {
+    g_error_free (err);
+    return -1;
+  }
+
+  return num;
+}
+
+void
+gst_droidcamsrc_cache_set_number_of_cameras (GstDroidCamSrcCache * cache,
+    gint num)
+{
+  if (cache->fingerprint) {
+    gst_droidcamsrc_cache_set_integer (cache, DEVICE_GROUP, "cameras", num);
+  }
+}
+
+gboolean
+gst_droidcamsrc_cache_get_info (GstDroidCamSrcCache * cache, gint num,
+    gint * facing, gint * orientation)
+{
+  GError *err = NULL;
+  gchar *group;
+  gint f, o = 0;
+
+  if (!cache->fingerprint) {
+    return FALSE;
+  }
+
+  group = gst_droidcamsrc_cache_group (num);
+
+  f = g_key_file_get_integer (cache->file, group, "facing", &err);
+  if (!err) {
+    o = g_key_file_get_integer (cache->file, group, "orientation", &err);
+  }
+
+  g_free (group);
+
+  if (err) {
+    g_error_free (err);
+    return FALSE;
+  }
+
+  *facing = f;
+  *orientation = o;
+
+  return TRUE;
+}
+
+void
+gst_droidcamsrc_cache_set_info (GstDroidCamSrcCache * cache, gint num,
+    gint facing, gint orientation)
+{
+  gchar *group;
+
+  if (!cache->fingerprint) {
+    return;
+  }
+
+  group = gst_droidcamsrc_cache_group (num);
+  gst_droidcamsrc_cache_set_integer (cache, group, "facing", facing);
+  gst_droidcamsrc_cache_set_integer (cache, group, "orientation", orientation);
+  g_free (group);
+}
+
+gchar *
+gst_droidcamsrc_cache_get_params (GstDroidCamSrcCache * cache, gint num,
+    GstVideoFormat * viewfinder_format)
+{
+  gchar *group;
+  gchar *format = NULL;
+  gchar *params = NULL;
+
+  if (!cache->fingerprint) {
+    return NULL;
+  }
+
+  group = gst_droidcamsrc_cache_group (num);
+
+  format =
+      g_key_file_get_string (cache->file, group, "viewfinder-format", NULL);
+  if (!format) {
+    goto out;
+  }
+
+  params = g_key_file_get_string (cache->file, group, "params", NULL);
+  if (params) {
+    *viewfinder_format = gst_video_format_from_string (format);
+  }
+
+out:
+  g_free (format);
+  g_free (group);
+
+  return params;
+}
+
+void
+gst_droidcamsrc_cache_set_params (GstDroidCamSrcCache * cache, gint num,
+    const gchar * params, GstVideoFormat viewfinder_format)
+{
+  gchar *group;
+  const gchar *format;
+
+  if (!cache->fingerprint) {
+    return;
+  }
+
+  format = gst_video_format_to_string (viewfinder_format);
+  if (!format) {
+    return;
+  }
+
+  group = gst_droidcamsrc_cache_group (num);
+  gst_droidcamsrc_cache_set_string (cache, group, "viewfinder-format", format);
+  gst_droidcamsrc_cache_set_string (cache, group, "params", params);
+  g_free (group);
+}
@@ -0,0 +1,50 @@
+/*
+ * gst-droid
+ *
+ * Copyright (C) 2014 Mohammed Sameer <msameer@foolab.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __GST_DROIDCAMSRC_CACHE_H__
+#define __GST_DROIDCAMSRC_CACHE_H__
+
+#include <glib.h>
+#include <gst/video/video.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GstDroidCamSrcCache GstDroidCamSrcCache;
+
+GstDroidCamSrcCache * gst_droidcamsrc_cache_new ();
+void gst_droidcamsrc_cache_destroy (GstDroidCamSrcCache * cache);
+void gst_droidcamsrc_cache_save (GstDroidCamSrcCache * cache);
+
+gint gst_droidcamsrc_cache_get_number_of_cameras (GstDroidCamSrcCache * cache);
+void gst_droidcamsrc_cache_set_number_of_cameras (GstDroidCamSrcCache * cache, gint num);
+
+gboolean gst_droidcamsrc_cache_get_info (GstDroidCamSrcCache * cache, gint num,
+    gint * facing, gint * orientation);
+void gst_droidcamsrc_cache_set_info (GstDroidCamSrcCache * cache, gint num,
+    gint facing, gint orientation);
+
+gchar *gst_droidcamsrc_cache_get_params (GstDroidCamSrcCache * cache, gint num,
+    GstVideoFormat * viewfinder_format);
+void gst_droidcamsrc_cache_set_params (GstDroidCamSrcCache * cache, gint num,
+    const gchar * params, GstVideoFormat viewfinder_format);
+
+G_END_DECLS
+
+#endif /* __GST_DROIDCAMSRC_CACHE_H__ */
@@ -31,7 +31,6 @@
 #include "gst/droid/gstwrappedmemory.h"
 #include "gst/droid/gstdroidbufferpool.h"
 #include <unistd.h>             /* usleep() */
-#include <string.h>             /* memcpy() */
 #ifndef GST_USE_UNSTABLE_API
 #define GST_USE_UNSTABLE_API
 #endif /* GST_USE_UNSTABLE_API */
@@ -45,11 +44,33 @@ GST_DEBUG_CATEGORY_EXTERN (gst_droid_camsrc_debug);
 
 #define VIDEO_RECORDING_STOP_TIMEOUT                 100000     /* us */
 #define GST_DROIDCAMSRC_NUM_BUFFERS                  2
+#define GST_DROIDCAMSRC_ZSL_RING_WAIT                500000     /* us */
+
+typedef enum
+{
+  GST_DROIDCAMSRC_DEV_JOB_IMAGE_DONE = 1,
+  GST_DROIDCAMSRC_DEV_JOB_ZSL_RING_CAPTURE,
+} GstDroidCamSrcDevJob;
 
 struct _GstDroidCamSrcImageCaptureState
 {
   gboolean image_preview_sent;
   gboolean image_start_sent;
+
+  /* recycled JPEG buffers. Only touched from the compressed image callback */
+  GstBufferPool *pool;
+  guint pool_size;
+
+  /* preview needs restarting after a non ZSL capture. protected by dev lock */
+  gboolean needs_restart;
+  GThreadPool *restart_worker;
+
+  /* last viewfinder frames for in-element ZSL. protected by zsl_lock */
+  GMutex zsl_lock;
+  GCond zsl_cond;
+  GQueue *zsl_ring;
+  GstClockTime zsl_shutter;
+  GstClockTime zsl_last_pts;
 };
 
 struct _GstDroidCamSrcVideoCaptureState
@@ -73,7 +94,10 @@ static void gst_droidcamsrc_dev_release_recording_frame (void *data,
 void gst_droidcamsrc_dev_update_params_locked (GstDroidCamSrcDev * dev);
 static void
 gst_droidcamsrc_dev_prepare_buffer (GstDroidCamSrcDev * dev, GstBuffer * buffer,
-    DroidMediaRect rect, GstVideoInfo * video_info);
+    DroidMediaRect rect, GstVideoInfo * video_info, gint64 timestamp);
+static void gst_droidcamsrc_dev_add_roi_meta (GstDroidCamSrcDev * dev,
+    GstBuffer * buffer, gint width, gint height);
+static void gst_droidcamsrc_dev_clear_faces (GstDroidCamSrcDev * dev);
 static gboolean
 gst_droidcamsrc_dev_start_video_recording_recorder_locked (GstDroidCamSrcDev *
     dev);
@@ -81,6 +105,11 @@ static gboolean
 gst_droidcamsrc_dev_start_video_recording_raw_locked (GstDroidCamSrcDev * dev);
 static void gst_droidcamsrc_dev_queue_video_buffer_locked (GstDroidCamSrcDev *
     dev, GstBuffer * buffer);
+static void gst_droidcamsrc_dev_zsl_ring_push (GstDroidCamSrcDev * dev,
+    GstBuffer * buffer);
+static void gst_droidcamsrc_dev_zsl_ring_clear (GstDroidCamSrcDev * dev);
+static gboolean gst_droidcamsrc_dev_zsl_ring_capture (GstDroidCamSrcDev * dev);
+static void gst_droidcamsrc_dev_flush_params (GstDroidCamSrcDev * dev);
 
 static void
 gst_droidcamsrc_dev_shutter_callback (void *user)
@@ -176,6 +205,53 @@ gst_droidcamsrc_dev_raw_image_callback (void *user,
   GST_FIXME_OBJECT (src, "implement me");
 }
 
+/* JPEG sizes vary between shots so leave some room on top of the last one */
+#define GST_DROIDCAMSRC_JPEG_POOL_HEADROOM(size) ((size) + (size) / 4)
+
+static GstBuffer *
+gst_droidcamsrc_dev_acquire_jpeg_buffer (GstDroidCamSrcDev * dev, gsize size)
+{
+  GstDroidCamSrc *src = GST_DROIDCAMSRC (GST_PAD_PARENT (dev->imgsrc->pad));
+  GstBuffer *buffer = NULL;
+
+  if (dev->img->pool && size > dev->img->pool_size) {
+    GST_DEBUG_OBJECT (src, "JPEG of %" G_GSIZE_FORMAT
+        " bytes does not fit the pool. Recreating it", size);
+
+    /* buffers still downstream get freed when they come back */
+    gst_buffer_pool_set_active (dev->img->pool, FALSE);
+    gst_object_unref (dev->img->pool);
+    dev->img->pool = NULL;
+  }
+
+  if (!dev->img->pool) {
+    GstStructure *config;
+    GstBufferPool *pool = gst_buffer_pool_new ();
+    guint pool_size = GST_DROIDCAMSRC_JPEG_POOL_HEADROOM (size);
+
+    config = gst_buffer_pool_get_config (pool);
+    gst_buffer_pool_config_set_params (config, NULL, pool_size, 0, 0);
+
+    if (!gst_buffer_pool_set_config (pool, config)
+        || !gst_buffer_pool_set_active (pool, TRUE)) {
+      GST_WARNING_OBJECT (src, "failed to set up JPEG buffer pool");
+      gst_object_unref (pool);
+    } else {
+      dev->img->pool = pool;
+      dev->img->pool_size = pool_size;
+    }
+  }
+
+  if (dev->img->pool
+      && gst_buffer_pool_acquire_buffer (dev->img->pool, &buffer,
+          NULL) == GST_FLOW_OK) {
+    gst_buffer_set_size (buffer, size);
+    return buffer;
+  }
+
+  return gst_buffer_new_allocate (NULL, size, NULL);
+}
+
 static void
 gst_droidcamsrc_dev_compressed_image_callback (void *user, DroidMediaData * mem)
 {
@@ -186,7 +262,6 @@ gst_droidcamsrc_dev_compressed_image_callback (void *user, DroidMediaData * mem)
   GstBuffer *buffer;
   GstTagList *tags;
   GstEvent *event = NULL;
-  void *d;
 
   GST_DEBUG_OBJECT (src, "dev compressed image callback");
 
@@ -195,10 +270,10 @@ gst_droidcamsrc_dev_compressed_image_callback (void *user, DroidMediaData * mem)
     return;
   }
 
-  /* TODO: research a way to get rid of the memcpy */
-  d = g_malloc (size);
-  memcpy (d, data, size);
-  buffer = gst_buffer_new_wrapped (d, size);
+  /* droidmedia frees the image once we return and cannot be asked to hold
+   * on to it so we still copy but into a recycled buffer. */
+  buffer = gst_droidcamsrc_dev_acquire_jpeg_buffer (dev, size);
+  gst_buffer_fill (buffer, 0, data, size);
   if (!dev->img->image_preview_sent) {
     gst_droidcamsrc_post_message (src,
         gst_structure_new_empty (GST_DROIDCAMSRC_CAPTURE_END));
@@ -207,8 +282,9 @@ gst_droidcamsrc_dev_compressed_image_callback (void *user, DroidMediaData * mem)
   }
 
   gst_droidcamsrc_timestamp (src, buffer);
+  gst_droidcamsrc_image_shot_delivered (src, buffer);
 
-  tags = gst_droidcamsrc_exif_tags_from_jpeg_data (d, size);
+  tags = gst_droidcamsrc_exif_tags_from_jpeg_data (data, size);
   if (tags) {
     GST_INFO_OBJECT (src, "pushing tags %" GST_PTR_FORMAT, tags);
     event = gst_event_new_tag (tags);
@@ -228,19 +304,51 @@ gst_droidcamsrc_dev_compressed_image_callback (void *user, DroidMediaData * mem)
 
   /* we need to restart the preview but only if we are not in ZSL mode.
    * android demands this but GStreamer does not know about it.
+   * Restarting takes a while so we do not hold the HAL thread for it.
+   * The worker also takes the next burst image and tells the application
+   * when we can capture again.
    */
   if (!(src->image_mode & GST_DROIDCAMSRC_IMAGE_MODE_ZSL)) {
     g_rec_mutex_lock (dev->lock);
     dev->running = FALSE;
+    dev->img->needs_restart = TRUE;
     g_rec_mutex_unlock (dev->lock);
+  }
+
+  g_thread_pool_push (dev->img->restart_worker,
+      GINT_TO_POINTER (GST_DROIDCAMSRC_DEV_JOB_IMAGE_DONE), NULL);
+}
+
+static void
+gst_droidcamsrc_dev_restart_preview (gpointer data, gpointer user_data)
+{
+  GstDroidCamSrcDev *dev = (GstDroidCamSrcDev *) user_data;
+  GstDroidCamSrc *src = GST_DROIDCAMSRC (GST_PAD_PARENT (dev->imgsrc->pad));
+
+  if (GPOINTER_TO_INT (data) == GST_DROIDCAMSRC_DEV_JOB_ZSL_RING_CAPTURE) {
+    gst_droidcamsrc_image_capture_done (src,
+        gst_droidcamsrc_dev_zsl_ring_capture (dev));
+    return;
+  }
+
+  g_rec_mutex_lock (dev->lock);
+
+  /* someone else might have stopped or restarted the preview meanwhile */
+  if (dev->img->needs_restart) {
+    GST_DEBUG_OBJECT (src, "restarting preview after capture");
     gst_droidcamsrc_dev_start (dev, TRUE);
   }
 
-  g_mutex_lock (&src->capture_lock);
-  --src->captures;
-  g_mutex_unlock (&src->capture_lock);
+  g_rec_mutex_unlock (dev->lock);
 
-  g_object_notify (G_OBJECT (src), "ready-for-capture");
+  gst_droidcamsrc_image_capture_done (src, TRUE);
+}
+
+static void
+gst_droidcamsrc_dev_params_worker (G_GNUC_UNUSED gpointer data,
+    gpointer user_data)
+{
+  gst_droidcamsrc_dev_flush_params ((GstDroidCamSrcDev *) user_data);
 }
 
 static void
@@ -274,7 +382,8 @@ gst_droidcamsrc_dev_preview_frame_callback (void *user,
   GstDroidCamSrc *src = GST_DROIDCAMSRC (GST_PAD_PARENT (dev->imgsrc->pad));
   GstDroidCamSrcPad *pad = dev->vfsrc;
   GstVideoInfo video_info;
-  GstBuffer *buffer;
+  GstBuffer *buffer = NULL;
+  GstBufferPool *pool;
   gsize width, height;
   DroidMediaRect rect;
 
@@ -290,7 +399,33 @@ gst_droidcamsrc_dev_preview_frame_callback (void *user,
     return;
   }
 
-  buffer = gst_buffer_new_allocate (NULL, mem->size, NULL);
+  /* droidmedia reclaims mem when we return so we cannot wrap it. Copy it
+   * into a recycled buffer instead of allocating one for every frame.
+   * We cannot take the device lock here because starting and stopping the
+   * preview hold it while waiting for the HAL. The pool is also replaced
+   * under the vfsrc pad lock which the HAL paths never hold. */
+  g_mutex_lock (&dev->vfsrc->lock);
+  pool = dev->pool ? gst_object_ref (dev->pool) : NULL;
+  g_mutex_unlock (&dev->vfsrc->lock);
+
+  if (pool) {
+    if (gst_buffer_pool_acquire_buffer (pool, &buffer, NULL) != GST_FLOW_OK) {
+      buffer = NULL;
+    } else if (gst_buffer_get_size (buffer) != mem->size) {
+      GST_LOG_OBJECT (src, "frame size %" G_GSIZE_FORMAT
+          " does not match pool buffer size %" G_GSIZE_FORMAT, mem->size,
+          gst_buffer_get_size (buffer));
+      gst_buffer_unref (buffer);
+      buffer = NULL;
+    }
+
+    gst_object_unref (pool);
+  }
+
+  if (!buffer) {
+    buffer = gst_buffer_new_allocate (NULL, mem->size, NULL);
+  }
+
   gst_buffer_fill (buffer, 0, mem->data, mem->size);
 
   GST_OBJECT_LOCK (src);
@@ -301,12 +436,11 @@ gst_droidcamsrc_dev_preview_frame_callback (void *user,
 
   gst_video_info_set_format (&video_info, GST_VIDEO_FORMAT_NV21, width, height);
 
-  gst_droidcamsrc_dev_prepare_buffer (dev, buffer, rect, &video_info);
+  /* raw preview data carries no timestamp */
+  gst_droidcamsrc_dev_prepare_buffer (dev, buffer, rect, &video_info, -1);
 
-  g_mutex_lock (&pad->lock);
-  g_queue_push_tail (pad->queue, buffer);
-  g_cond_signal (&pad->cond);
-  g_mutex_unlock (&pad->lock);
+  gst_droidcamsrc_dev_zsl_ring_push (dev, buffer);
+  gst_droidcamsrc_pad_queue_buffer (pad, buffer);
 }
 
 static void
@@ -319,13 +453,12 @@ gst_droidcamsrc_dev_video_frame_callback (void *user,
   GstBuffer *buffer;
   GstMemory *mem;
   GstDroidCamSrcDevVideoData *mem_data;
+  gboolean have_faces;
 
   GST_DEBUG_OBJECT (src, "dev video frame callback");
 
   g_mutex_lock (&dev->vid->lock);
 
-  /* TODO: not sure what to do with timestamp */
-
   /* unlikely but just in case */
   if (G_UNLIKELY (!data)) {
     GST_ERROR ("invalid memory from camera HAL");
@@ -344,7 +477,30 @@ gst_droidcamsrc_dev_video_frame_callback (void *user,
       (GFunc) gst_droidcamsrc_dev_release_recording_frame, mem_data);
   gst_buffer_insert_memory (buffer, 0, mem);
 
+#if HAVE_DECL_DROID_MEDIA_CAMERA_RECORDING_FRAME_GET_TIMESTAMP
+  gst_droidcamsrc_timestamp_hal (src, buffer,
+      droid_media_camera_recording_frame_get_timestamp (video_data));
+#else
   gst_droidcamsrc_timestamp (src, buffer);
+#endif
+
+  /* The frame itself is opaque so we need the negotiated size */
+  g_mutex_lock (&dev->roi_lock);
+  have_faces = dev->faces->len > 0;
+  g_mutex_unlock (&dev->roi_lock);
+
+  if (have_faces) {
+    GstCaps *caps = gst_pad_get_current_caps (dev->vidsrc->pad);
+    GstVideoInfo info;
+
+    if (caps && gst_video_info_from_caps (&info, caps)) {
+      gst_droidcamsrc_dev_add_roi_meta (dev, buffer, info.width, info.height);
+    }
+
+    if (caps) {
+      gst_caps_unref (caps);
+    }
+  }
 
   gst_droidcamsrc_dev_queue_video_buffer_locked (dev, buffer);
 
@@ -372,6 +528,12 @@ gst_droidcamsrc_dev_preview_metadata_callback (void *user,
 
   GST_INFO_OBJECT (src, "camera detected %d faces", num_faces);
 
+  /* Keep them around so we can attach them to the frames we push */
+  g_mutex_lock (&dev->roi_lock);
+  g_array_set_size (dev->faces, 0);
+  g_array_append_vals (dev->faces, faces, num_faces);
+  g_mutex_unlock (&dev->roi_lock);
+
   GST_OBJECT_LOCK (src);
   width = src->width;
   height = src->height;
@@ -424,6 +586,8 @@ gst_droidcamsrc_dev_buffers_released (G_GNUC_UNUSED void *user)
   GstDroidCamSrcDev *dev = (GstDroidCamSrcDev *) user;
   GstBufferPool *pool = gst_object_ref (dev->pool);
 
+  gst_droidcamsrc_dev_zsl_ring_clear (dev);
+
   if (pool) {
     gst_droid_buffer_pool_media_buffers_invalidated (pool);
     gst_object_unref (pool);
@@ -498,12 +662,11 @@ gst_droidcamsrc_dev_frame_available (void *user, DroidMediaBuffer * buffer)
   }
 
   gst_droidcamsrc_dev_prepare_buffer (dev, buff, rect,
-      gst_droid_media_buffer_get_video_info_from_gst_buffer (buff));
+      gst_droid_media_buffer_get_video_info_from_gst_buffer (buff),
+      info.timestamp);
 
-  g_mutex_lock (&pad->lock);
-  g_queue_push_tail (pad->queue, buff);
-  g_cond_signal (&pad->cond);
-  g_mutex_unlock (&pad->lock);
+  gst_droidcamsrc_dev_zsl_ring_push (dev, buff);
+  gst_droidcamsrc_pad_queue_buffer (pad, buff);
 
   return true;
 }
@@ -528,6 +691,19 @@ gst_droidcamsrc_dev_new (GstDroidCamSrcPad * vfsrc,
   g_mutex_init (&dev->vid->lock);
   g_cond_init (&dev->vid->cond);
 
+  dev->img->restart_worker =
+      g_thread_pool_new (gst_droidcamsrc_dev_restart_preview, dev, 1, FALSE,
+      NULL);
+  dev->params_worker =
+      g_thread_pool_new (gst_droidcamsrc_dev_params_worker, dev, 1, FALSE,
+      NULL);
+
+  g_mutex_init (&dev->img->zsl_lock);
+  g_cond_init (&dev->img->zsl_cond);
+  dev->img->zsl_ring = g_queue_new ();
+  dev->img->zsl_shutter = GST_CLOCK_TIME_NONE;
+  dev->img->zsl_last_pts = GST_CLOCK_TIME_NONE;
+
   dev->wrap_allocator = gst_wrapped_memory_allocator_new ();
   dev->media_allocator = gst_droid_media_buffer_allocator_new ();
   dev->vfsrc = vfsrc;
@@ -544,6 +720,9 @@ gst_droidcamsrc_dev_new (GstDroidCamSrcPad * vfsrc,
 
   dev->viewfinder_format = GST_VIDEO_FORMAT_UNKNOWN;
 
+  g_mutex_init (&dev->roi_lock);
+  dev->faces = g_array_new (FALSE, FALSE, sizeof (DroidMediaCameraFace));
+
   return dev;
 }
 
@@ -630,6 +809,15 @@ gst_droidcamsrc_dev_destroy (GstDroidCamSrcDev * dev)
 {
   GST_DEBUG ("dev destroy");
 
+  /* wait for a pending preview restart and parameter update */
+  g_thread_pool_free (dev->img->restart_worker, FALSE, TRUE);
+  g_thread_pool_free (dev->params_worker, FALSE, TRUE);
+
+  gst_droidcamsrc_dev_zsl_ring_clear (dev);
+  g_queue_free (dev->img->zsl_ring);
+  g_mutex_clear (&dev->img->zsl_lock);
+  g_cond_clear (&dev->img->zsl_cond);
+
   dev->cam = NULL;
   dev->queue = NULL;
   dev->info = NULL;
@@ -646,8 +834,16 @@ gst_droidcamsrc_dev_destroy (GstDroidCamSrcDev * dev)
     gst_object_unref (dev->pool);
   }
 
+  if (dev->img->pool) {
+    gst_buffer_pool_set_active (dev->img->pool, FALSE);
+    gst_object_unref (dev->img->pool);
+  }
+
   gst_droidcamsrc_recorder_destroy (dev->recorder);
 
+  g_array_free (dev->faces, TRUE);
+  g_mutex_clear (&dev->roi_lock);
+
   g_slice_free (GstDroidCamSrcImageCaptureState, dev->img);
   g_slice_free (GstDroidCamSrcVideoCaptureState, dev->vid);
   g_slice_free (GstDroidCamSrcDev, dev);
@@ -718,6 +914,8 @@ gst_droidcamsrc_dev_start (GstDroidCamSrcDev * dev, gboolean apply_settings)
 
   g_rec_mutex_lock (dev->lock);
 
+  dev->img->needs_restart = FALSE;
+
   if (dev->running) {
     GST_WARNING_OBJECT (src, "preview is already running");
     ret = TRUE;
@@ -750,6 +948,9 @@ gst_droidcamsrc_dev_start (GstDroidCamSrcDev * dev, gboolean apply_settings)
         dev->c.CAMERA_FRAME_CALLBACK_FLAG_NOOP);
   }
 
+  /* the HAL clock might not continue where the last preview stopped */
+  gst_droidcamsrc_timestamp_reset (src);
+
   if (!droid_media_camera_start_preview (dev->cam)) {
     GST_ERROR_OBJECT (src, "error starting preview");
     goto out;
@@ -775,6 +976,11 @@ gst_droidcamsrc_dev_stop (GstDroidCamSrcDev * dev)
 
   GST_DEBUG ("dev stop");
 
+  dev->img->needs_restart = FALSE;
+
+  /* give the HAL buffers back before the pool goes away */
+  gst_droidcamsrc_dev_zsl_ring_clear (dev);
+
   if (dev->running) {
     GST_DEBUG ("stopping preview");
     gst_buffer_pool_set_active (dev->pool, FALSE);
@@ -783,6 +989,8 @@ gst_droidcamsrc_dev_stop (GstDroidCamSrcDev * dev)
     GST_DEBUG ("stopped preview");
   }
 
+  gst_droidcamsrc_dev_clear_faces (dev);
+
   /* Now we need to empty the queue */
   g_mutex_lock (&dev->vfsrc->lock);
   g_queue_foreach (dev->vfsrc->queue, (GFunc) gst_buffer_unref, NULL);
@@ -816,16 +1024,30 @@ gst_droidcamsrc_dev_set_params (GstDroidCamSrcDev * dev)
     goto out;
   }
 
-  params = gst_droidcamsrc_params_to_string (dev->params);
+  params = gst_droidcamsrc_params_get_update (dev->params);
+  if (!params) {
+    ++dev->params_unchanged;
+    ret = TRUE;
+    goto out;
+  }
+
   GST_LOG ("setting parameters %s", params);
   err = droid_media_camera_set_parameters (dev->cam, params);
-  g_free (params);
+
+  dev->params_last_set = g_get_monotonic_time ();
+  ++dev->params_hal_updates;
 
   if (!err) {
     GST_ERROR ("error setting parameters");
+    gst_droidcamsrc_params_set_failed (dev->params);
+    g_free (params);
     goto out;
   }
 
+  /* only now we know what the HAL has */
+  gst_droidcamsrc_params_set_sent (dev->params, params);
+  g_free (params);
+
   ret = TRUE;
 
 out:
@@ -834,6 +1056,81 @@ out:
   return ret;
 }
 
+/* Setters call this. While the preview is running changes are collected
+ * and handed to the HAL at most once per frame */
+gboolean
+gst_droidcamsrc_dev_queue_params (GstDroidCamSrcDev * dev)
+{
+  gboolean ret = TRUE;
+
+  g_rec_mutex_lock (dev->lock);
+
+  if (!dev->running) {
+    ret = gst_droidcamsrc_dev_set_params (dev);
+    goto out;
+  }
+
+  if (dev->params_queued) {
+    GST_LOG ("parameter update already queued");
+    ++dev->params_coalesced;
+    goto out;
+  }
+
+  if (!dev->params || !gst_droidcamsrc_params_is_dirty (dev->params)) {
+    goto out;
+  }
+
+  dev->params_queued = TRUE;
+  g_thread_pool_push (dev->params_worker, GINT_TO_POINTER (TRUE), NULL);
+
+out:
+  g_rec_mutex_unlock (dev->lock);
+
+  return ret;
+}
+
+static void
+gst_droidcamsrc_dev_flush_params (GstDroidCamSrcDev * dev)
+{
+  GstDroidCamSrc *src = GST_DROIDCAMSRC (GST_PAD_PARENT (dev->imgsrc->pad));
+  gint64 interval = G_TIME_SPAN_SECOND / 30;
+  gint64 wait;
+  gboolean ret = TRUE;
+
+  GST_OBJECT_LOCK (src);
+  if (src->fps_n > 0 && src->fps_d > 0) {
+    interval =
+        gst_util_uint64_scale_int (G_TIME_SPAN_SECOND, src->fps_d, src->fps_n);
+  }
+  GST_OBJECT_UNLOCK (src);
+
+  g_rec_mutex_lock (dev->lock);
+  wait = dev->params_last_set + interval - g_get_monotonic_time ();
+  g_rec_mutex_unlock (dev->lock);
+
+  /* let more changes pile up until a frame has passed since the last update */
+  if (wait > 0) {
+    g_usleep (wait);
+  }
+
+  g_rec_mutex_lock (dev->lock);
+
+  dev->params_queued = FALSE;
+
+  if (dev->cam && dev->params) {
+    ret = gst_droidcamsrc_dev_set_params (dev);
+  }
+
+  g_rec_mutex_unlock (dev->lock);
+
+  /* the setter returned long ago so this is our only chance to tell */
+  if (!ret) {
+    GST_ELEMENT_WARNING (src, LIBRARY, SETTINGS, (NULL),
+        ("camera HAL rejected the parameter update. Retrying with the next "
+            "change"));
+  }
+}
+
 gboolean
 gst_droidcamsrc_dev_capture_image (GstDroidCamSrcDev * dev)
 {
@@ -848,6 +1145,11 @@ gst_droidcamsrc_dev_capture_image (GstDroidCamSrcDev * dev)
   dev->img->image_preview_sent = FALSE;
   dev->img->image_start_sent = FALSE;
 
+  /* do not let queued settings miss the picture */
+  if (!gst_droidcamsrc_dev_set_params (dev)) {
+    GST_WARNING ("failed to apply queued parameters");
+  }
+
   if (!droid_media_camera_take_picture (dev->cam, msg_type)) {
     GST_ERROR ("error capturing image");
     goto out;
@@ -860,6 +1162,21 @@ out:
   return ret;
 }
 
+void
+gst_droidcamsrc_dev_capture_image_from_zsl_ring (GstDroidCamSrcDev * dev,
+    GstClockTime shutter)
+{
+  GST_DEBUG ("dev capture image from ZSL ring");
+
+  g_mutex_lock (&dev->img->zsl_lock);
+  dev->img->zsl_shutter = shutter;
+  g_mutex_unlock (&dev->img->zsl_lock);
+
+  /* copying the frame out takes time so do it on the worker */
+  g_thread_pool_push (dev->img->restart_worker,
+      GINT_TO_POINTER (GST_DROIDCAMSRC_DEV_JOB_ZSL_RING_CAPTURE), NULL);
+}
+
 gboolean
 gst_droidcamsrc_dev_start_video_recording (GstDroidCamSrcDev * dev)
 {
@@ -872,6 +1189,7 @@ gst_droidcamsrc_dev_start_video_recording (GstDroidCamSrcDev * dev)
 
   g_mutex_lock (&dev->vidsrc->lock);
   dev->vidsrc->pushed_buffers = 0;
+  dev->vidsrc->encoded = dev->use_recorder;
   g_mutex_unlock (&dev->vidsrc->lock);
 
   g_rec_mutex_lock (dev->lock);
@@ -1078,6 +1396,10 @@ gst_droidcamsrc_dev_enable_face_detection (GstDroidCamSrcDev * dev,
     goto out;
   }
 
+  if (!enable) {
+    gst_droidcamsrc_dev_clear_faces (dev);
+  }
+
   res = TRUE;
 
 out:
@@ -1128,16 +1450,60 @@ gst_droidcamsrc_dev_is_running (GstDroidCamSrcDev * dev)
   return ret;
 }
 
+static void
+gst_droidcamsrc_dev_clear_faces (GstDroidCamSrcDev * dev)
+{
+  g_mutex_lock (&dev->roi_lock);
+  g_array_set_size (dev->faces, 0);
+  g_mutex_unlock (&dev->roi_lock);
+}
+
+static void
+gst_droidcamsrc_dev_add_roi_meta (GstDroidCamSrcDev * dev, GstBuffer * buffer,
+    gint width, gint height)
+{
+  guint i;
+
+  g_mutex_lock (&dev->roi_lock);
+
+  for (i = 0; i < dev->faces->len; i++) {
+    DroidMediaCameraFace *face =
+        &g_array_index (dev->faces, DroidMediaCameraFace, i);
+    GstVideoRegionOfInterestMeta *meta;
+    guint x, y, r, b;
+
+    /* HAL coordinates are -1000 to 1000 */
+    x = gst_util_uint64_scale (CLAMP (face->left, -1000, 1000) + 1000, width,
+        2000);
+    y = gst_util_uint64_scale (CLAMP (face->top, -1000, 1000) + 1000, height,
+        2000);
+    r = gst_util_uint64_scale (CLAMP (face->right, -1000, 1000) + 1000, width,
+        2000);
+    b = gst_util_uint64_scale (CLAMP (face->bottom, -1000, 1000) + 1000,
+        height, 2000);
+
+    if (r <= x || b <= y) {
+      continue;
+    }
+
+    meta = gst_buffer_add_video_region_of_interest_meta (buffer, "face", x, y,
+        r - x, b - y);
+    meta->id = face->id;
+  }
+
+  g_mutex_unlock (&dev->roi_lock);
+}
+
 static void
 gst_droidcamsrc_dev_prepare_buffer (GstDroidCamSrcDev * dev, GstBuffer * buffer,
-    DroidMediaRect rect, GstVideoInfo * video_info)
+    DroidMediaRect rect, GstVideoInfo * video_info, gint64 timestamp)
 {
   GstDroidCamSrc *src = GST_DROIDCAMSRC (GST_PAD_PARENT (dev->imgsrc->pad));
   GstVideoCropMeta *crop;
 
   GST_LOG_OBJECT (src, "prepare buffer %" GST_PTR_FORMAT, buffer);
 
-  gst_droidcamsrc_timestamp (src, buffer);
+  gst_droidcamsrc_timestamp_hal (src, buffer, timestamp);
 
   crop = gst_buffer_add_video_crop_meta (buffer);
   crop->x = rect.left;
@@ -1152,6 +1518,9 @@ gst_droidcamsrc_dev_prepare_buffer (GstDroidCamSrcDev * dev, GstBuffer * buffer,
       video_info->finfo->format, video_info->width, video_info->height,
       video_info->finfo->n_planes, video_info->offset, video_info->stride);
 
+  gst_droidcamsrc_dev_add_roi_meta (dev, buffer, video_info->width,
+      video_info->height);
+
   GST_LOG_OBJECT (src, "preview info: w=%d, h=%d, crop: x=%d, y=%d, w=%d, h=%d",
       video_info->width, video_info->height, crop->x, crop->y, crop->width,
       crop->height);
@@ -1230,12 +1599,245 @@ gst_droidcamsrc_dev_queue_video_buffer_locked (GstDroidCamSrcDev * dev,
         "dropping buffer because video recording is not running");
     gst_buffer_unref (buffer);
   } else {
-    g_mutex_lock (&dev->vidsrc->lock);
-    g_queue_push_tail (dev->vidsrc->queue, buffer);
-    g_cond_signal (&dev->vidsrc->cond);
-    g_mutex_unlock (&dev->vidsrc->lock);
+    gst_droidcamsrc_pad_queue_buffer (dev->vidsrc, buffer);
   }
 
   /* in case stop_video_recording() is waiting for us */
   g_cond_signal (&dev->vid->cond);
 }
+
+static void
+gst_droidcamsrc_dev_zsl_ring_push (GstDroidCamSrcDev * dev, GstBuffer * buffer)
+{
+  GstDroidCamSrc *src = GST_DROIDCAMSRC (GST_PAD_PARENT (dev->imgsrc->pad));
+  guint size = 0;
+
+  GST_OBJECT_LOCK (src);
+  if (src->zsl_ring_active) {
+    size = src->zsl_ring_size;
+  }
+  GST_OBJECT_UNLOCK (src);
+
+  g_mutex_lock (&dev->img->zsl_lock);
+
+  if (size > 0) {
+    g_queue_push_tail (dev->img->zsl_ring, gst_buffer_ref (buffer));
+    g_cond_signal (&dev->img->zsl_cond);
+  }
+
+  while (g_queue_get_length (dev->img->zsl_ring) > size) {
+    gst_buffer_unref (g_queue_pop_head (dev->img->zsl_ring));
+  }
+
+  g_mutex_unlock (&dev->img->zsl_lock);
+}
+
+static void
+gst_droidcamsrc_dev_zsl_ring_clear (GstDroidCamSrcDev * dev)
+{
+  g_mutex_lock (&dev->img->zsl_lock);
+  g_queue_foreach (dev->img->zsl_ring, (GFunc) gst_buffer_unref, NULL);
+  g_queue_clear (dev->img->zsl_ring);
+  dev->img->zsl_last_pts = GST_CLOCK_TIME_NONE;
+  g_mutex_unlock (&dev->img->zsl_lock);
+}
+
+/* zsl_lock must be held. Picks the frame closest to the shutter that has
+ * not been captured yet */
+static GstBuffer *
+gst_droidcamsrc_dev_zsl_ring_pick_locked (GstDroidCamSrcDev * dev)
+{
+  GstClockTime shutter = dev->img->zsl_shutter;
+  GstClockTime last = dev->img->zsl_last_pts;
+  GstClockTime best = GST_CLOCK_TIME_NONE;
+  GstBuffer *frame = NULL;
+  GList *l;
+
+  for (l = dev->img->zsl_ring->head; l; l = l->next) {
+    GstBuffer *buffer = (GstBuffer *) l->data;
+    GstClockTime pts = GST_BUFFER_PTS (buffer);
+    GstClockTime diff;
+
+    if (GST_CLOCK_TIME_IS_VALID (last) && GST_CLOCK_TIME_IS_VALID (pts)
+        && pts <= last) {
+      continue;
+    }
+
+    if (!GST_CLOCK_TIME_IS_VALID (shutter) || !GST_CLOCK_TIME_IS_VALID (pts)) {
+      /* the newest frame wins */
+      frame = buffer;
+      continue;
+    }
+
+    diff = pts > shutter ? pts - shutter : shutter - pts;
+    if (!GST_CLOCK_TIME_IS_VALID (best) || diff <= best) {
+      best = diff;
+      frame = buffer;
+    }
+  }
+
+  return frame ? gst_buffer_ref (frame) : NULL;
+}
+
+gboolean
+gst_droidcamsrc_dev_zsl_ring_supports_format (GstVideoFormat format)
+{
+  switch (format) {
+    case GST_VIDEO_FORMAT_NV21:
+    case GST_VIDEO_FORMAT_NV12:
+    case GST_VIDEO_FORMAT_YV12:
+      return TRUE;
+    default:
+      return FALSE;
+  }
+}
+
+static gboolean
+gst_droidcamsrc_dev_zsl_ring_capture (GstDroidCamSrcDev * dev)
+{
+  GstDroidCamSrc *src = GST_DROIDCAMSRC (GST_PAD_PARENT (dev->imgsrc->pad));
+  GstBuffer *frame;
+  GstBuffer *buffer = NULL;
+  GstVideoMeta *meta;
+  GstVideoCropMeta *in_crop, *crop;
+  GstVideoInfo in_info, out_info;
+  GstVideoFrame in_frame, out_frame;
+  GstCaps *caps, *current;
+  GstEvent *event = NULL;
+  gint64 end_time = g_get_monotonic_time () + GST_DROIDCAMSRC_ZSL_RING_WAIT;
+  gboolean ret = FALSE;
+
+  g_mutex_lock (&dev->img->zsl_lock);
+
+  /* a burst might be faster than the viewfinder */
+  while (!(frame = gst_droidcamsrc_dev_zsl_ring_pick_locked (dev))) {
+    if (!g_cond_wait_until (&dev->img->zsl_cond, &dev->img->zsl_lock,
+            end_time)) {
+      break;
+    }
+  }
+
+  if (frame) {
+    dev->img->zsl_last_pts = GST_BUFFER_PTS (frame);
+  }
+
+  g_mutex_unlock (&dev->img->zsl_lock);
+
+  if (!frame) {
+    GST_ELEMENT_WARNING (src, RESOURCE, FAILED,
+        ("No viewfinder frame available for capture"), (NULL));
+    return FALSE;
+  }
+
+  GST_DEBUG_OBJECT (src, "capturing frame %" GST_TIME_FORMAT " for shutter %"
+      GST_TIME_FORMAT, GST_TIME_ARGS (GST_BUFFER_PTS (frame)),
+      GST_TIME_ARGS (dev->img->zsl_shutter));
+
+  meta = gst_buffer_get_video_meta (frame);
+  if (!meta) {
+    GST_ERROR_OBJECT (src, "viewfinder frame has no video meta");
+    goto out;
+  }
+
+  /* imgsrc negotiated the viewfinder format. Never hand out anything else.
+   * Caps might not be set yet if the viewfinder had no size back then */
+  current = gst_pad_get_current_caps (dev->imgsrc->pad);
+  if (!gst_droidcamsrc_dev_zsl_ring_supports_format (meta->format)
+      || (current && (!gst_video_info_from_caps (&out_info, current)
+              || GST_VIDEO_INFO_FORMAT (&out_info) != meta->format))) {
+    GST_ELEMENT_WARNING (src, STREAM, FORMAT,
+        ("Viewfinder frame format %s does not match the image caps",
+            gst_video_format_to_string (meta->format)),
+        ("caps %" GST_PTR_FORMAT, current));
+    if (current) {
+      gst_caps_unref (current);
+    }
+    goto out;
+  }
+
+  if (current) {
+    gst_caps_unref (current);
+  }
+
+  /* the format is a known raw one here so this cannot fail */
+  gst_video_info_set_format (&in_info, meta->format, meta->width,
+      meta->height);
+  out_info = in_info;
+
+  /* ring frames belong to the HAL buffer queue so copy them out. This also
+   * packs the planes for the downstream encoder */
+  buffer = gst_buffer_new_allocate (NULL, out_info.size, NULL);
+
+  if (!gst_video_frame_map (&in_frame, &in_info, frame, GST_MAP_READ)) {
+    GST_ERROR_OBJECT (src, "failed to map viewfinder frame");
+    goto out;
+  }
+
+  if (!gst_video_frame_map (&out_frame, &out_info, buffer, GST_MAP_WRITE)) {
+    GST_ERROR_OBJECT (src, "failed to map image buffer");
+    gst_video_frame_unmap (&in_frame);
+    goto out;
+  }
+
+  ret = gst_video_frame_copy (&out_frame, &in_frame);
+
+  gst_video_frame_unmap (&out_frame);
+  gst_video_frame_unmap (&in_frame);
+
+  if (!ret) {
+    GST_ERROR_OBJECT (src, "failed to copy viewfinder frame");
+    goto out;
+  }
+
+  gst_buffer_copy_into (buffer, frame, GST_BUFFER_COPY_TIMESTAMPS, 0, -1);
+
+  in_crop = gst_buffer_get_video_crop_meta (frame);
+  if (in_crop) {
+    crop = gst_buffer_add_video_crop_meta (buffer);
+    crop->x = in_crop->x;
+    crop->y = in_crop->y;
+    crop->width = in_crop->width;
+    crop->height = in_crop->height;
+  }
+
+  caps = gst_video_info_to_caps (&out_info);
+  current = gst_pad_get_current_caps (dev->imgsrc->pad);
+  if (!current || !gst_caps_is_equal (current, caps)) {
+    event = gst_event_new_caps (caps);
+  }
+
+  if (current) {
+    gst_caps_unref (current);
+  }
+
+  gst_caps_unref (caps);
+
+  gst_droidcamsrc_post_message (src,
+      gst_structure_new_empty (GST_DROIDCAMSRC_CAPTURE_START));
+  gst_droidcamsrc_post_message (src,
+      gst_structure_new_empty (GST_DROIDCAMSRC_CAPTURE_END));
+
+  gst_droidcamsrc_image_shot_delivered (src, buffer);
+
+  g_mutex_lock (&dev->imgsrc->lock);
+
+  if (event) {
+    dev->imgsrc->pending_events =
+        g_list_append (dev->imgsrc->pending_events, event);
+  }
+
+  g_queue_push_tail (dev->imgsrc->queue, buffer);
+  g_cond_signal (&dev->imgsrc->cond);
+  g_mutex_unlock (&dev->imgsrc->lock);
+
+  buffer = NULL;
+
+out:
+  if (buffer) {
+    gst_buffer_unref (buffer);
+  }
+
+  gst_buffer_unref (frame);
+
+  return ret;
+}
@@ -52,12 +52,26 @@ struct _GstDroidCamSrcDev
   GstDroidCamSrcCamInfo *info;
   GstDroidCamSrcImageCaptureState *img;
   GstDroidCamSrcVideoCaptureState *vid;
+  /* replaced under both the device lock and the vfsrc pad lock */
   GstBufferPool *pool;
   DroidMediaCameraConstants c;
   GstVideoFormat viewfinder_format;
 
   gboolean use_recorder;
   GstDroidCamSrcRecorder *recorder;
+
+  /* last detected faces in HAL coordinates. protected by roi_lock */
+  GMutex roi_lock;
+  GArray *faces;
+
+  /* parameter updates. protected by lock. Flushed on their own thread so
+   * captures and preview restarts never wait for them or the other way round */
+  GThreadPool *params_worker;
+  gboolean params_queued;
+  gint64 params_last_set;
+  guint params_hal_updates;
+  guint params_coalesced;
+  guint params_unchanged;
 };
 
 GstDroidCamSrcDev *gst_droidcamsrc_dev_new (GstDroidCamSrcPad *vfsrc,
@@ -75,8 +89,11 @@ gboolean gst_droidcamsrc_dev_start (GstDroidCamSrcDev * dev, gboolean apply_sett
 void gst_droidcamsrc_dev_stop (GstDroidCamSrcDev * dev);
 
 gboolean gst_droidcamsrc_dev_set_params (GstDroidCamSrcDev * dev);
+gboolean gst_droidcamsrc_dev_queue_params (GstDroidCamSrcDev * dev);
 
 gboolean gst_droidcamsrc_dev_capture_image (GstDroidCamSrcDev * dev);
+void gst_droidcamsrc_dev_capture_image_from_zsl_ring (GstDroidCamSrcDev * dev, GstClockTime shutter);
+gboolean gst_droidcamsrc_dev_zsl_ring_supports_format (GstVideoFormat format);
 
 gboolean gst_droidcamsrc_dev_start_video_recording (GstDroidCamSrcDev * dev);
 void gst_droidcamsrc_dev_stop_video_recording (GstDroidCamSrcDev * dev);
@@ -61,3 +61,23 @@ gst_droidcamsrc_image_mode_get_type (void)
   }
   return gst_droidcamsrc_image_mode_type;
 }
+
+GType
+gst_droidcamsrc_leaky_get_type (void)
+{
+  static GType gst_droidcamsrc_leaky_type = 0;
+  static GEnumValue gst_droidcamsrc_leaky[] = {
+    {GST_DROIDCAMSRC_LEAKY_NONE, "Not leaky", "none"},
+    {GST_DROIDCAMSRC_LEAKY_UPSTREAM, "Leaky on upstream (new buffers)",
+        "upstream"},
+    {GST_DROIDCAMSRC_LEAKY_DOWNSTREAM, "Leaky on downstream (old buffers)",
+        "downstream"},
+    {0, NULL, NULL},
+  };
+
+  if (G_UNLIKELY (!gst_droidcamsrc_leaky_type)) {
+    gst_droidcamsrc_leaky_type =
+        g_enum_register_static ("GstDroidCamSrcLeaky", gst_droidcamsrc_leaky);
+  }
+  return gst_droidcamsrc_leaky_type;
+}
@@ -28,6 +28,7 @@ G_BEGIN_DECLS
 
 #define GST_TYPE_DROIDCAMSRC_CAMERA_DEVICE (gst_droidcamsrc_camera_device_get_type())
 #define GST_TYPE_DROIDCAMSRC_IMAGE_MODE (gst_droidcamsrc_image_mode_get_type())
+#define GST_TYPE_DROIDCAMSRC_LEAKY (gst_droidcamsrc_leaky_get_type())
 
 typedef enum {
   GST_DROIDCAMSRC_CAMERA_DEVICE_PRIMARY = 0,
@@ -45,6 +46,14 @@ typedef enum {
 GType gst_droidcamsrc_image_mode_get_type (void);
 GType gst_droidcamsrc_supported_image_modes_get_type (void);
 
+typedef enum {
+  GST_DROIDCAMSRC_LEAKY_NONE = 0,
+  GST_DROIDCAMSRC_LEAKY_UPSTREAM = 1,
+  GST_DROIDCAMSRC_LEAKY_DOWNSTREAM = 2,
+} GstDroidCamSrcLeaky;
+
+GType gst_droidcamsrc_leaky_get_type (void);
+
 typedef enum {
   GST_DROIDCAMSRC_ROI_FOCUS_AREA = 0x1,
   GST_DROIDCAMSRC_ROI_METERING_AREA = 0x2,
@@ -160,6 +160,102 @@ gst_droidcamsrc_params_fill_fps_range_arrays_locked (GstDroidCamSrcParams *
   }
 }
 
+static GArray *
+gst_droidcamsrc_params_parse_sizes_locked (GstDroidCamSrcParams * params,
+    const gchar * key)
+{
+  GArray *sizes = g_array_new (FALSE, FALSE, sizeof (GstDroidCamSrcParamsSize));
+  gchar *value = g_hash_table_lookup (params->params, key);
+  gchar **vals, **tmp;
+
+  if (!value) {
+    return sizes;
+  }
+
+  vals = g_strsplit (value, ",", -1);
+
+  for (tmp = vals; *tmp; tmp++) {
+    GstDroidCamSrcParamsSize size;
+
+    if (gst_droidcamsrc_params_parse_dimension (*tmp, &size.width,
+            &size.height)) {
+      g_array_append_val (sizes, size);
+    }
+  }
+
+  g_strfreev (vals);
+
+  GST_LOG ("parsed %u sizes from %s", sizes->len, key);
+
+  return sizes;
+}
+
+static void
+gst_droidcamsrc_params_clear_caps_locked (GstDroidCamSrcParams * params)
+{
+  gst_caps_replace (&params->viewfinder_caps, NULL);
+  gst_caps_replace (&params->video_caps, NULL);
+  gst_caps_replace (&params->image_caps, NULL);
+}
+
+static void
+gst_droidcamsrc_params_clear_tables_locked (GstDroidCamSrcParams * params)
+{
+  if (params->preview_sizes) {
+    g_array_free (params->preview_sizes, TRUE);
+    params->preview_sizes = NULL;
+  }
+
+  if (params->video_sizes) {
+    g_array_free (params->video_sizes, TRUE);
+    params->video_sizes = NULL;
+  }
+
+  if (params->picture_sizes) {
+    g_array_free (params->picture_sizes, TRUE);
+    params->picture_sizes = NULL;
+  }
+
+  if (params->values) {
+    g_hash_table_unref (params->values);
+    params->values = NULL;
+  }
+
+  gst_droidcamsrc_params_clear_caps_locked (params);
+}
+
+/* The HAL advertises what it supports in *-values keys. Those only change
+ * when we reload so split them once */
+static void
+gst_droidcamsrc_params_fill_tables_locked (GstDroidCamSrcParams * params)
+{
+  GHashTableIter iter;
+  gpointer key, value;
+
+  gst_droidcamsrc_params_clear_tables_locked (params);
+
+  params->preview_sizes =
+      gst_droidcamsrc_params_parse_sizes_locked (params, "preview-size-values");
+  params->picture_sizes =
+      gst_droidcamsrc_params_parse_sizes_locked (params, "picture-size-values");
+  params->video_sizes =
+      gst_droidcamsrc_params_parse_sizes_locked (params,
+      params->has_separate_video_size_values ? "video-size-values" :
+      "preview-size-values");
+
+  params->values = g_hash_table_new_full (g_str_hash, g_str_equal,
+      (GDestroyNotify) g_free, (GDestroyNotify) g_strfreev);
+
+  g_hash_table_iter_init (&iter, params->params);
+
+  while (g_hash_table_iter_next (&iter, &key, &value)) {
+    if (g_str_has_suffix ((gchar *) key, "-values")) {
+      g_hash_table_insert (params->values, g_strdup (key),
+          g_strsplit ((gchar *) value, ",", -1));
+    }
+  }
+}
+
 void
 gst_droidcamsrc_params_reload_locked (GstDroidCamSrcParams * params,
     const gchar * str)
@@ -187,6 +283,12 @@ gst_droidcamsrc_params_reload_locked (GstDroidCamSrcParams * params,
     GST_ERROR ("reloading discarded unset parameters");
   }
 
+  /* we do not know what the HAL has any more */
+  g_free (params->string);
+  params->string = NULL;
+  g_free (params->sent);
+  params->sent = NULL;
+
   /* now try to extract preview-fps-range-values */
   if (params->min_fps_range) {
     g_array_free (params->min_fps_range, TRUE);
@@ -203,6 +305,8 @@ gst_droidcamsrc_params_reload_locked (GstDroidCamSrcParams * params,
   params->is_dirty = FALSE;
   params->has_separate_video_size_values =
       g_hash_table_lookup (params->params, "video-size-values") != NULL;
+
+  gst_droidcamsrc_params_fill_tables_locked (params);
 }
 
 GstDroidCamSrcParams *
@@ -231,6 +335,11 @@ gst_droidcamsrc_params_destroy (GstDroidCamSrcParams * params)
     g_array_free (params->max_fps_range, TRUE);
   }
 
+  g_free (params->string);
+  g_free (params->sent);
+
+  gst_droidcamsrc_params_clear_tables_locked (params);
+
   g_mutex_clear (&params->lock);
   g_hash_table_unref (params->params);
   g_slice_free (GstDroidCamSrcParams, params);
@@ -246,30 +355,44 @@ gst_droidcamsrc_params_reload (GstDroidCamSrcParams * params, const gchar * str)
   g_mutex_unlock (&params->lock);
 }
 
-gchar *
-gst_droidcamsrc_params_to_string (GstDroidCamSrcParams * params)
+static const gchar *
+gst_droidcamsrc_params_to_string_locked (GstDroidCamSrcParams * params)
 {
-  gchar *string = NULL;
+  GString *string;
   GHashTableIter iter;
   gpointer key, value;
 
-  g_mutex_lock (&params->lock);
+  if (params->string) {
+    return params->string;
+  }
+
+  string = g_string_sized_new (4096);
 
   g_hash_table_iter_init (&iter, params->params);
 
   while (g_hash_table_iter_next (&iter, &key, &value)) {
-    gchar *str = g_strdup_printf ("%s=%s", (gchar *) key, (gchar *) value);
-
-    if (string == NULL) {
-      string = str;
-    } else {
-      gchar *new_string = g_strjoin (";", string, str, NULL);
-      g_free (string);
-      g_free (str);
-      string = new_string;
+    if (string->len > 0) {
+      g_string_append_c (string, ';');
     }
+
+    g_string_append (string, (gchar *) key);
+    g_string_append_c (string, '=');
+    g_string_append (string, (gchar *) value);
   }
 
+  params->string = g_string_free (string, FALSE);
+
+  return params->string;
+}
+
+gchar *
+gst_droidcamsrc_params_to_string (GstDroidCamSrcParams * params)
+{
+  gchar *string;
+
+  g_mutex_lock (&params->lock);
+
+  string = g_strdup (gst_droidcamsrc_params_to_string_locked (params));
   params->is_dirty = FALSE;
 
   g_mutex_unlock (&params->lock);
@@ -277,6 +400,60 @@ gst_droidcamsrc_params_to_string (GstDroidCamSrcParams * params)
   return string;
 }
 
+/* Returns the string to hand to the HAL or NULL if the HAL has it already.
+ * Call gst_droidcamsrc_params_set_sent () once the HAL accepted it or
+ * gst_droidcamsrc_params_set_failed () if it did not. */
+gchar *
+gst_droidcamsrc_params_get_update (GstDroidCamSrcParams * params)
+{
+  const gchar *string;
+  gchar *update = NULL;
+
+  g_mutex_lock (&params->lock);
+
+  if (!params->is_dirty) {
+    goto out;
+  }
+
+  params->is_dirty = FALSE;
+
+  string = gst_droidcamsrc_params_to_string_locked (params);
+
+  /* values might have been changed and then changed back */
+  if (!g_strcmp0 (string, params->sent)) {
+    GST_DEBUG ("parameters did not change since the last update");
+    goto out;
+  }
+
+  update = g_strdup (string);
+
+out:
+  g_mutex_unlock (&params->lock);
+
+  return update;
+}
+
+void
+gst_droidcamsrc_params_set_sent (GstDroidCamSrcParams * params,
+    const gchar * sent)
+{
+  g_mutex_lock (&params->lock);
+
+  g_free (params->sent);
+  params->sent = g_strdup (sent);
+
+  g_mutex_unlock (&params->lock);
+}
+
+/* The HAL rejected the update. Keep it dirty so the next attempt retries */
+void
+gst_droidcamsrc_params_set_failed (GstDroidCamSrcParams * params)
+{
+  g_mutex_lock (&params->lock);
+  params->is_dirty = TRUE;
+  g_mutex_unlock (&params->lock);
+}
+
 gboolean
 gst_droidcamsrc_params_is_dirty (GstDroidCamSrcParams * params)
 {
@@ -289,15 +466,46 @@ gst_droidcamsrc_params_is_dirty (GstDroidCamSrcParams * params)
   return is_dirty;
 }
 
+/* Compares the values only. The order we hold them in does not matter. */
+gboolean
+gst_droidcamsrc_params_equal (GstDroidCamSrcParams * params,
+    GstDroidCamSrcParams * other)
+{
+  GHashTableIter iter;
+  gpointer key, value;
+  gboolean ret = TRUE;
+
+  g_mutex_lock (&params->lock);
+  g_mutex_lock (&other->lock);
+
+  if (g_hash_table_size (params->params) != g_hash_table_size (other->params)) {
+    ret = FALSE;
+    goto out;
+  }
+
+  g_hash_table_iter_init (&iter, params->params);
+
+  while (g_hash_table_iter_next (&iter, &key, &value)) {
+    if (g_strcmp0 (value, g_hash_table_lookup (other->params, key)) != 0) {
+      ret = FALSE;
+      break;
+    }
+  }
+
+out:
+  g_mutex_unlock (&other->lock);
+  g_mutex_unlock (&params->lock);
+
+  return ret;
+}
+
 static GstCaps *
 gst_droidcamsrc_params_get_caps_locked (GstDroidCamSrcParams * params,
-    const gchar * key, const gchar * media, const gchar * features,
+    GArray * sizes, const gchar * media, const gchar * features,
     const gchar * format)
 {
-  gchar *value;
   GstCaps *caps = gst_caps_new_empty ();
-  gchar **vals;
-  gchar **tmp;
+  guint i;
   int fps;
 
   fps = gst_droidcamsrc_params_get_int_locked (params, "preview-frame-rate");
@@ -306,71 +514,55 @@ gst_droidcamsrc_params_get_caps_locked (GstDroidCamSrcParams * params,
     return caps;
   }
 
-  value = g_hash_table_lookup (params->params, key);
-  if (!value) {
-    return caps;
-  }
-
-  vals = g_strsplit (value, ",", -1);
-  tmp = vals;
-  if (!vals || !vals[0]) {
-    return caps;
-  }
-
-  while (*tmp) {
-    int w, h;
+  for (i = 0; i < sizes->len; i++) {
+    GstDroidCamSrcParamsSize *size =
+        &g_array_index (sizes, GstDroidCamSrcParamsSize, i);
     GstCaps *caps2;
-    if (gst_droidcamsrc_params_parse_dimension (*tmp, &w, &h)) {
-      caps2 = gst_caps_new_simple (media,
-          "width", G_TYPE_INT, w, "height", G_TYPE_INT, h, NULL);
 
-      if (format) {
-        gst_caps_set_simple (caps2, "format", G_TYPE_STRING, format, NULL);
-      }
+    caps2 = gst_caps_new_simple (media,
+        "width", G_TYPE_INT, size->width, "height", G_TYPE_INT, size->height,
+        NULL);
 
-      if (features) {
-        gst_caps_set_features (caps2, 0, gst_caps_features_new (features,
-                NULL));
-      }
+    if (format) {
+      gst_caps_set_simple (caps2, "format", G_TYPE_STRING, format, NULL);
+    }
 
-      /* now add frame rate */
-      if (params->min_fps_range->len == 0) {
-        /* the easy part first */
-        gst_caps_set_simple (caps2, "framerate", GST_TYPE_FRACTION, fps, 1,
-            NULL);
-        GST_DEBUG ("merging caps %" GST_PTR_FORMAT, caps2);
-        caps = gst_caps_merge (caps, caps2);
-      } else {
-        int x;
-        for (x = 0; x < params->min_fps_range->len; x++) {
-          GstCaps *caps3;
-          int min = g_array_index (params->min_fps_range, gint, x);
-          int max = g_array_index (params->max_fps_range, gint, x);
-          min /= 1000;
-          max /= 1000;
-
-          caps3 = gst_caps_copy (caps2);
-          if (min == max) {
-            gst_caps_set_simple (caps3, "framerate", GST_TYPE_FRACTION, min, 1,
-                NULL);
-          } else {
-            gst_caps_set_simple (caps3, "framerate", GST_TYPE_FRACTION_RANGE,
-                min, 1, max, 1, NULL);
-          }
-
-          GST_DEBUG ("merging caps %" GST_PTR_FORMAT, caps3);
-          caps = gst_caps_merge (caps, caps3);
+    if (features) {
+      gst_caps_set_features (caps2, 0, gst_caps_features_new (features, NULL));
+    }
+
+    /* now add frame rate */
+    if (params->min_fps_range->len == 0) {
+      /* the easy part first */
+      gst_caps_set_simple (caps2, "framerate", GST_TYPE_FRACTION, fps, 1, NULL);
+      GST_DEBUG ("merging caps %" GST_PTR_FORMAT, caps2);
+      caps = gst_caps_merge (caps, caps2);
+    } else {
+      int x;
+      for (x = 0; x < params->min_fps_range->len; x++) {
+        GstCaps *caps3;
+        int min = g_array_index (params->min_fps_range, gint, x);
+        int max = g_array_index (params->max_fps_range, gint, x);
+        min /= 1000;
+        max /= 1000;
+
+        caps3 = gst_caps_copy (caps2);
+        if (min == max) {
+          gst_caps_set_simple (caps3, "framerate", GST_TYPE_FRACTION, min, 1,
+              NULL);
+        } else {
+          gst_caps_set_simple (caps3, "framerate", GST_TYPE_FRACTION_RANGE,
+              min, 1, max, 1, NULL);
         }
 
-        gst_caps_unref (caps2);
+        GST_DEBUG ("merging caps %" GST_PTR_FORMAT, caps3);
+        caps = gst_caps_merge (caps, caps3);
       }
-    }
 
-    ++tmp;
+      gst_caps_unref (caps2);
+    }
   }
 
-  g_strfreev (vals);
-
   return gst_caps_simplify (caps);
 }
 
@@ -381,13 +573,24 @@ gst_droidcamsrc_params_get_viewfinder_caps (GstDroidCamSrcParams * params,
   GstCaps *caps;
 
   g_mutex_lock (&params->lock);
-  caps =
-      gst_caps_merge (gst_droidcamsrc_params_get_caps_locked (params,
-          "preview-size-values", "video/x-raw",
-          GST_CAPS_FEATURE_MEMORY_DROID_MEDIA_QUEUE_BUFFER,
-          gst_video_format_to_string (format)),
-      gst_droidcamsrc_params_get_caps_locked (params, "preview-size-values",
-          "video/x-raw", NULL, "NV21"));
+
+  if (params->viewfinder_caps && params->viewfinder_caps_format != format) {
+    gst_caps_replace (&params->viewfinder_caps, NULL);
+  }
+
+  if (!params->viewfinder_caps) {
+    params->viewfinder_caps =
+        gst_caps_merge (gst_droidcamsrc_params_get_caps_locked (params,
+            params->preview_sizes, "video/x-raw",
+            GST_CAPS_FEATURE_MEMORY_DROID_MEDIA_QUEUE_BUFFER,
+            gst_video_format_to_string (format)),
+        gst_droidcamsrc_params_get_caps_locked (params, params->preview_sizes,
+            "video/x-raw", NULL, "NV21"));
+    params->viewfinder_caps_format = format;
+  }
+
+  caps = gst_caps_ref (params->viewfinder_caps);
+
   g_mutex_unlock (&params->lock);
 
   return caps;
@@ -400,12 +603,13 @@ gst_droidcamsrc_params_get_video_caps (GstDroidCamSrcParams * params)
 
   g_mutex_lock (&params->lock);
 
-  gchar *key =
-      params->has_separate_video_size_values ? "video-size-values" :
-      "preview-size-values";
+  if (!params->video_caps) {
+    params->video_caps =
+        gst_droidcamsrc_params_get_caps_locked (params, params->video_sizes,
+        "video/x-raw", GST_CAPS_FEATURE_MEMORY_DROID_VIDEO_META_DATA, "YV12");
+  }
 
-  caps = gst_droidcamsrc_params_get_caps_locked (params, key,
-      "video/x-raw", GST_CAPS_FEATURE_MEMORY_DROID_VIDEO_META_DATA, "YV12");
+  caps = gst_caps_ref (params->video_caps);
 
   g_mutex_unlock (&params->lock);
 
@@ -418,13 +622,44 @@ gst_droidcamsrc_params_get_image_caps (GstDroidCamSrcParams * params)
   GstCaps *caps;
 
   g_mutex_lock (&params->lock);
-  caps = gst_droidcamsrc_params_get_caps_locked (params, "picture-size-values",
-      "image/jpeg", NULL, NULL);
+
+  if (!params->image_caps) {
+    params->image_caps =
+        gst_droidcamsrc_params_get_caps_locked (params, params->picture_sizes,
+        "image/jpeg", NULL, NULL);
+  }
+
+  caps = gst_caps_ref (params->image_caps);
+
   g_mutex_unlock (&params->lock);
 
   return caps;
 }
 
+gboolean
+gst_droidcamsrc_params_has_picture_size (GstDroidCamSrcParams * params,
+    gint width, gint height)
+{
+  gboolean ret = FALSE;
+  guint i;
+
+  g_mutex_lock (&params->lock);
+
+  for (i = 0; i < params->picture_sizes->len; i++) {
+    GstDroidCamSrcParamsSize *size =
+        &g_array_index (params->picture_sizes, GstDroidCamSrcParamsSize, i);
+
+    if (size->width == width && size->height == height) {
+      ret = TRUE;
+      break;
+    }
+  }
+
+  g_mutex_unlock (&params->lock);
+
+  return ret;
+}
+
 void
 gst_droidcamsrc_params_set_string_locked (GstDroidCamSrcParams * params,
     const gchar * key, const gchar * value)
@@ -439,6 +674,13 @@ gst_droidcamsrc_params_set_string_locked (GstDroidCamSrcParams * params,
   if (g_strcmp0 (val, value)) {
     g_hash_table_insert (params->params, g_strdup (key), g_strdup (value));
     params->is_dirty = TRUE;
+    g_free (params->string);
+    params->string = NULL;
+
+    /* caps fall back to it when there are no fps ranges */
+    if (!g_strcmp0 (key, "preview-frame-rate")) {
+      gst_droidcamsrc_params_clear_caps_locked (params);
+    }
   }
 }
 
@@ -451,6 +693,20 @@ gst_droidcamsrc_params_set_string (GstDroidCamSrcParams * params,
   g_mutex_unlock (&params->lock);
 }
 
+/* Valid until the next reload */
+const gchar *const *
+gst_droidcamsrc_params_get_values (GstDroidCamSrcParams * params,
+    const char *key)
+{
+  const gchar *const *values;
+
+  g_mutex_lock (&params->lock);
+  values = g_hash_table_lookup (params->values, key);
+  g_mutex_unlock (&params->lock);
+
+  return values;
+}
+
 const gchar *
 gst_droidcamsrc_params_get_string (GstDroidCamSrcParams * params,
     const char *key)
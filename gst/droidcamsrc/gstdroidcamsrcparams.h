@@ -27,14 +27,35 @@
 G_BEGIN_DECLS
 
 typedef struct _GstDroidCamSrcParams GstDroidCamSrcParams;
+typedef struct _GstDroidCamSrcParamsSize GstDroidCamSrcParamsSize;
+
+struct _GstDroidCamSrcParamsSize
+{
+  gint width;
+  gint height;
+};
 
 struct _GstDroidCamSrcParams
 {
   GHashTable *params;
   gboolean is_dirty;
+  /* serialized params, NULL when stale */
+  gchar *string;
+  /* last string handed to the HAL */
+  gchar *sent;
   GArray *min_fps_range, *max_fps_range;
   gboolean has_separate_video_size_values;
   GMutex lock;
+
+  /* parsed once per reload */
+  GArray *preview_sizes, *video_sizes, *picture_sizes;
+  GHashTable *values;
+
+  /* built on demand, dropped on reload */
+  GstCaps *viewfinder_caps;
+  GstVideoFormat viewfinder_caps_format;
+  GstCaps *video_caps;
+  GstCaps *image_caps;
 };
 
 GstDroidCamSrcParams * gst_droidcamsrc_params_new (const gchar * params);
@@ -43,7 +64,11 @@ gboolean gst_droidcamsrc_has_param (GstDroidCamSrcParams * params, const char *k
 void gst_droidcamsrc_params_reload (GstDroidCamSrcParams *params, const gchar * str);
 
 gchar *gst_droidcamsrc_params_to_string (GstDroidCamSrcParams *params);
+gchar *gst_droidcamsrc_params_get_update (GstDroidCamSrcParams *params);
+void gst_droidcamsrc_params_set_sent (GstDroidCamSrcParams *params, const gchar *sent);
+void gst_droidcamsrc_params_set_failed (GstDroidCamSrcParams *params);
 gboolean gst_droidcamsrc_params_is_dirty (GstDroidCamSrcParams *params);
+gboolean gst_droidcamsrc_params_equal (GstDroidCamSrcParams *params, GstDroidCamSrcParams *other);
 
 GstCaps *gst_droidcamsrc_params_get_viewfinder_caps (GstDroidCamSrcParams *params, GstVideoFormat format);
 GstCaps *gst_droidcamsrc_params_get_video_caps (GstDroidCamSrcParams *params);
@@ -51,6 +76,8 @@ GstCaps *gst_droidcamsrc_params_get_image_caps (GstDroidCamSrcParams *params);
 
 void gst_droidcamsrc_params_set_string (GstDroidCamSrcParams *params, const gchar *key, const gchar *value);
 const gchar *gst_droidcamsrc_params_get_string (GstDroidCamSrcParams * params, const char *key);
+const gchar * const *gst_droidcamsrc_params_get_values (GstDroidCamSrcParams * params, const char *key);
+gboolean gst_droidcamsrc_params_has_picture_size (GstDroidCamSrcParams * params, gint width, gint height);
 int gst_droidcamsrc_params_get_int (GstDroidCamSrcParams * params, const char *key);
 float gst_droidcamsrc_params_get_float (GstDroidCamSrcParams * params, const char *key);
 
@@ -194,8 +194,8 @@ struct DataEntry FlickerValues[] = {
 
 static GList *gst_droidcamsrc_photography_append_list (GList * list,
     const int key, const gchar * value);
-static GList *gst_droidcamsrc_photography_create_list (const gchar * params,
-    struct DataEntry entries[], gsize len);
+static GList *gst_droidcamsrc_photography_create_list (const gchar *
+    const *values, struct DataEntry entries[], gsize len);
 
 #define PHOTO_IFACE_FUNC(name, tset, tget)					\
   static gboolean gst_droidcamsrc_get_##name (GstDroidCamSrc * src, tget val); \
@@ -831,7 +831,7 @@ gst_droidcamsrc_photography_update_params (GstDroidCamSrc * src)
     g_list_free_full (src->photo->flash, (GDestroyNotify) free_data_entry);
   }
   src->photo->flash =
-      gst_droidcamsrc_photography_create_list (gst_droidcamsrc_params_get_string
+      gst_droidcamsrc_photography_create_list (gst_droidcamsrc_params_get_values
       (src->dev->params, "flash-mode-values"), FlashValues,
       G_N_ELEMENTS (FlashValues));
 
@@ -840,7 +840,7 @@ gst_droidcamsrc_photography_update_params (GstDroidCamSrc * src)
     g_list_free_full (src->photo->color_tone, (GDestroyNotify) free_data_entry);
   }
   src->photo->color_tone =
-      gst_droidcamsrc_photography_create_list (gst_droidcamsrc_params_get_string
+      gst_droidcamsrc_photography_create_list (gst_droidcamsrc_params_get_values
       (src->dev->params, "effect-values"), ColourToneValues,
       G_N_ELEMENTS (ColourToneValues));
 
@@ -849,7 +849,7 @@ gst_droidcamsrc_photography_update_params (GstDroidCamSrc * src)
     g_list_free_full (src->photo->focus, (GDestroyNotify) free_data_entry);
   }
   src->photo->focus =
-      gst_droidcamsrc_photography_create_list (gst_droidcamsrc_params_get_string
+      gst_droidcamsrc_photography_create_list (gst_droidcamsrc_params_get_values
       (src->dev->params, "focus-mode-values"), FocusValues,
       G_N_ELEMENTS (FocusValues));
 
@@ -858,7 +858,7 @@ gst_droidcamsrc_photography_update_params (GstDroidCamSrc * src)
     g_list_free_full (src->photo->scene, (GDestroyNotify) free_data_entry);
   }
   src->photo->scene =
-      gst_droidcamsrc_photography_create_list (gst_droidcamsrc_params_get_string
+      gst_droidcamsrc_photography_create_list (gst_droidcamsrc_params_get_values
       (src->dev->params, "scene-mode-values"), SceneValues,
       G_N_ELEMENTS (SceneValues));
 
@@ -867,7 +867,7 @@ gst_droidcamsrc_photography_update_params (GstDroidCamSrc * src)
     g_list_free_full (src->photo->wb, (GDestroyNotify) free_data_entry);
   }
   src->photo->wb =
-      gst_droidcamsrc_photography_create_list (gst_droidcamsrc_params_get_string
+      gst_droidcamsrc_photography_create_list (gst_droidcamsrc_params_get_values
       (src->dev->params, "whitebalance-values"), WhiteBalanceValues,
       G_N_ELEMENTS (WhiteBalanceValues));
 
@@ -878,13 +878,13 @@ gst_droidcamsrc_photography_update_params (GstDroidCamSrc * src)
   if (gst_droidcamsrc_has_param (src->dev->params, "iso-values")) {
     src->photo->iso =
         gst_droidcamsrc_photography_create_list
-        (gst_droidcamsrc_params_get_string (src->dev->params, "iso-values"),
+        (gst_droidcamsrc_params_get_values (src->dev->params, "iso-values"),
         ISOValues, G_N_ELEMENTS (ISOValues));
     src->photo->iso_key = "iso";
   } else if (gst_droidcamsrc_has_param (src->dev->params, "iso-speed-values")) {
     src->photo->iso =
         gst_droidcamsrc_photography_create_list
-        (gst_droidcamsrc_params_get_string (src->dev->params,
+        (gst_droidcamsrc_params_get_values (src->dev->params,
             "iso-speed-values"), ISOValues, G_N_ELEMENTS (ISOValues));
     src->photo->iso_key = "iso-speed";
   }
@@ -896,7 +896,7 @@ gst_droidcamsrc_photography_update_params (GstDroidCamSrc * src)
     g_list_free_full (src->photo->flicker, (GDestroyNotify) free_data_entry);
   }
   src->photo->flicker =
-      gst_droidcamsrc_photography_create_list (gst_droidcamsrc_params_get_string
+      gst_droidcamsrc_photography_create_list (gst_droidcamsrc_params_get_values
       (src->dev->params, "antibanding-values"), FlickerValues,
       G_N_ELEMENTS (FlickerValues));
 
@@ -978,7 +978,7 @@ gst_droidcamsrc_photography_apply (GstDroidCamSrc * src,
   GST_OBJECT_UNLOCK (src);
 
   if (type == SET_AND_APPLY) {
-    gst_droidcamsrc_apply_params (src);
+    gst_droidcamsrc_queue_params (src);
   }
 }
 
@@ -993,19 +993,17 @@ gst_droidcamsrc_photography_append_list (GList * list, const int key,
 }
 
 static GList *
-gst_droidcamsrc_photography_create_list (const gchar * params,
+gst_droidcamsrc_photography_create_list (const gchar * const *values,
     struct DataEntry entries[], gsize len)
 {
   int x;
   GList *list = NULL;
-  if (params == NULL) {
+  if (values == NULL) {
     GST_WARNING ("No params supplied. Returning empty list");
     return list;
   }
-  // Split the params
-  gchar **p = g_strsplit (params, ",", -1);
   for (x = 0; x < len; x++) {   // look for each entry, so they can each occur only once
-    gchar **tmp = p;
+    const gchar *const *tmp = values;
     while (*tmp) {
       // Special handling for continuous focus - we have to choose -picture or -video depending on mode
       if (!g_strcmp0 (*tmp, entries[x].value)
@@ -1020,7 +1018,6 @@ gst_droidcamsrc_photography_create_list (const gchar * params,
       ++tmp;
     }
   }
-  g_strfreev (p);
   return list;
 }
 
@@ -1534,7 +1531,7 @@ gst_droidcamsrc_set_and_apply (GstDroidCamSrc * src, const gchar * key,
 
   gst_droidcamsrc_params_set_string (src->dev->params, key, value);
 
-  return gst_droidcamsrc_apply_params (src);
+  return gst_droidcamsrc_queue_params (src);
 }
 
 void
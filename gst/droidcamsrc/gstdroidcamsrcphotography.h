@@ -43,6 +43,7 @@ typedef enum
   PROP_MIN_EV_COMPENSATION,
   PROP_MAX_EV_COMPENSATION,
   PROP_FACE_DETECTION,
+  PROP_VIDEO_FACE_DETECTION,
   PROP_IMAGE_NOISE_REDUCTION,
   PROP_SENSOR_ORIENTATION,
   PROP_SENSOR_MOUNT_ANGLE,
@@ -53,6 +54,16 @@ typedef enum
   PROP_SUPPORTED_FLASH_MODES,
   PROP_SUPPORTED_FOCUS_MODES,
   PROP_SUPPORTED_ISO_SPEEDS,
+  PROP_VIEWFINDER_MAX_QUEUE_SIZE,
+  PROP_VIEWFINDER_LEAKY,
+  PROP_VIDEO_MAX_QUEUE_SIZE,
+  PROP_VIDEO_LEAKY,
+  PROP_QUEUE_STATS,
+  PROP_CAPTURE_STATS,
+  PROP_BURST_COUNT,
+  PROP_BURST_INTERVAL,
+  PROP_ZSL_RING_SIZE,
+  PROP_PARAM_STATS,
 
   /* photography interface */
   PROP_WB_MODE,
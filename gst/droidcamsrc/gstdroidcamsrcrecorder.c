@@ -39,6 +39,7 @@ gst_droidcamsrc_recorder_create (GstDroidCamSrcPad * vidsrc)
   recorder->md.bitrate = GST_DROIDCAMSRC_RECORDER_TARGET_BITRATE_DEFAULT;
   recorder->md.meta_data = true;
   recorder->md.parent.flags = DROID_MEDIA_CODEC_HW_ONLY;
+  recorder->pool = gst_droid_bucket_pool_new ();
 
   return recorder;
 }
@@ -50,6 +51,8 @@ gst_droidcamsrc_recorder_destroy (GstDroidCamSrcRecorder * recorder)
     gst_droid_codec_unref (recorder->codec);
   }
 
+  gst_droid_bucket_pool_free (recorder->pool);
+
   g_free (recorder);
 }
 
@@ -157,7 +160,8 @@ gst_droidcamsrc_recorder_data_available (void *data,
   }
 
   buffer =
-      gst_droid_codec_prepare_encoded_data (recorder->codec, &encoded->data);
+      gst_droid_codec_prepare_encoded_data (recorder->codec, &encoded->data,
+      recorder->pool);
   if (!buffer) {
     GST_ELEMENT_ERROR (src, LIBRARY, ENCODE, (NULL),
         ("failed to process encoded data"));
@@ -24,6 +24,7 @@
 #include <gst/gst.h>
 #include <gst/video/video.h>
 #include <droidmediarecorder.h>
+#include <gst/droid/gstdroidbucketpool.h>
 
 G_BEGIN_DECLS
 
@@ -39,6 +40,7 @@ struct _GstDroidCamSrcRecorder
   GstDroidCodec *codec;
   DroidMediaRecorder *recorder;
   DroidMediaCodecEncoderMetaData md;
+  GstDroidBucketPool *pool;
 };
 
 GstDroidCamSrcRecorder *gst_droidcamsrc_recorder_create (GstDroidCamSrcPad *vidsrc);
@@ -49,6 +49,7 @@ static void gst_droidadec_signal_eos (void *data);
 static void gst_droidadec_data_available (void *data,
     DroidMediaCodecData * encoded);
 static GstFlowReturn gst_droidadec_finish (GstAudioDecoder * decoder);
+static GstBuffer *gst_droidadec_take_buffer (GstDroidADec * dec, gsize size);
 
 static gboolean
 gst_droidadec_create_codec (GstDroidADec * dec, GstBuffer * input)
@@ -168,9 +169,11 @@ gst_droidadec_data_available (void *data, DroidMediaCodecData * encoded)
     dec->info = gst_audio_decoder_get_audio_info (GST_AUDIO_DECODER (dec));
   }
 
+  /* droidmedia takes the data back once we return so this is the only copy
+   * we make. Everything below only moves references around. */
   out = gst_audio_decoder_allocate_output_buffer (decoder, encoded->data.size);
 
-  gst_buffer_map (out, &info, GST_MAP_READWRITE);
+  gst_buffer_map (out, &info, GST_MAP_WRITE);
   orc_memcpy (info.data, encoded->data.data, encoded->data.size);
   gst_buffer_unmap (out, &info);
 
@@ -184,7 +187,7 @@ gst_droidadec_data_available (void *data, DroidMediaCodecData * encoded)
   gst_adapter_push (dec->adapter, out);
 
   if (gst_adapter_available (dec->adapter) >= dec->spf * dec->info->bpf) {
-    out = gst_adapter_take_buffer (dec->adapter, dec->spf * dec->info->bpf);
+    out = gst_droidadec_take_buffer (dec, dec->spf * dec->info->bpf);
   } else {
     flow_ret = GST_FLOW_OK;
     goto out;
@@ -210,6 +213,18 @@ out:
   GST_AUDIO_DECODER_STREAM_UNLOCK (decoder);
 }
 
+static GstBuffer *
+gst_droidadec_take_buffer (GstDroidADec * dec, gsize size)
+{
+#if GST_CHECK_VERSION(1,6,0)
+  /* Hands out the memories already in the adapter instead of merging
+   * them into a new allocation when the data straddles buffers. */
+  return gst_adapter_take_buffer_fast (dec->adapter, size);
+#else
+  return gst_adapter_take_buffer (dec->adapter, size);
+#endif
+}
+
 static void
 gst_droidadec_signal_eos (void *data)
 {
@@ -456,10 +471,10 @@ finish:
 
       GST_INFO_OBJECT (dec, "pushing remaining %d bytes", available);
       if (nframes > 0) {
-        out = gst_adapter_take_buffer (dec->adapter, nframes * size);
+        out = gst_droidadec_take_buffer (dec, nframes * size);
         available -= (nframes * size);
       } else {
-        out = gst_adapter_take_buffer (dec->adapter, available);
+        out = gst_droidadec_take_buffer (dec, available);
         nframes = 1;
         available = 0;
       }
@@ -47,10 +47,85 @@ enum
 
 #define GST_DROID_A_ENC_TARGET_BITRATE_DEFAULT 128000
 
+/* AMR only knows a fixed set of modes */
+static const gint amr_nb_bitrates[] = {
+  4750, 5150, 5900, 6700, 7400, 7950, 10200, 12200, 0
+};
+
+static const gint amr_wb_bitrates[] = {
+  6600, 8850, 12650, 14250, 15850, 18250, 19850, 23050, 23850, 0
+};
+
+typedef struct
+{
+  GstMapInfo info;
+  GstBuffer *buffer;
+} GstDroidAEncBufferReleaseData;
+
 static void gst_droidaenc_signal_eos (void *data);
 static void gst_droidaenc_error (void *data, int err);
 static void gst_droidaenc_data_available (void *data,
     DroidMediaCodecData * encoded);
+static void gst_droidaenc_release_input_buffer (void *data);
+
+static gint
+gst_droidaenc_get_bitrate (GstDroidAEnc * enc, const gchar * droid)
+{
+  const gint *modes;
+  gint bitrate;
+  int x;
+
+  if (!g_strcmp0 (droid, "audio/3gpp")) {
+    modes = amr_nb_bitrates;
+  } else if (!g_strcmp0 (droid, "audio/amr-wb")) {
+    modes = amr_wb_bitrates;
+  } else {
+    return enc->target_bitrate;
+  }
+
+  /* the highest mode not above the target or the lowest one */
+  bitrate = modes[0];
+  for (x = 1; modes[x]; x++) {
+    if (modes[x] <= enc->target_bitrate) {
+      bitrate = modes[x];
+    }
+  }
+
+  if (bitrate != enc->target_bitrate) {
+    GST_INFO_OBJECT (enc, "using AMR mode %d for target bitrate %d", bitrate,
+        enc->target_bitrate);
+  }
+
+  return bitrate;
+}
+
+static gint
+gst_droidaenc_get_samples_per_frame (GstCaps * caps)
+{
+  GstStructure *s = gst_caps_get_structure (caps, 0);
+  gint mpegversion = -1;
+  gint spf = gst_droid_codec_get_samples_per_frane (caps);
+
+  if (spf != -1) {
+    return spf;
+  }
+
+  /* AMR always uses 20ms frames */
+  if (gst_structure_has_name (s, "audio/AMR")) {
+    return 160;
+  } else if (gst_structure_has_name (s, "audio/AMR-WB")) {
+    return 320;
+  }
+
+  /* AAC-LC, the only AAC profile the android encoders produce by default */
+  if (gst_structure_has_name (s, "audio/mpeg")
+      && gst_structure_get_int (s, "mpegversion", &mpegversion)
+      && mpegversion == 4) {
+    return 1024;
+  }
+
+  return -1;
+}
 
 static gboolean
 gst_droidaenc_negotiate_src_caps (GstDroidAEnc * enc, GstAudioInfo * info)
@@ -82,6 +157,8 @@ gst_droidaenc_negotiate_src_caps (GstDroidAEnc * enc, GstAudioInfo * info)
   gst_caps_set_simple (caps, "channels", G_TYPE_INT, info->channels, "rate",
       G_TYPE_INT, info->rate, NULL);
 
+  enc->spf = gst_droidaenc_get_samples_per_frame (caps);
+
   gst_caps_replace (&enc->caps, caps);
   gst_caps_unref (caps);
 
@@ -109,19 +186,15 @@ gst_droidaenc_create_codec (GstDroidAEnc * enc)
   md.parent.type = droid;
   md.parent.channels = enc->channels;
   md.parent.sample_rate = enc->rate;
-  md.parent.flags = DROID_MEDIA_CODEC_SW_ONLY;
+  /* AAC sticks to the software encoder. AMR may be offloaded to the DSP */
+  md.parent.flags =
+      g_strcmp0 (droid, "audio/mp4a-latm") ? 0 : DROID_MEDIA_CODEC_SW_ONLY;
   md.meta_data = false;
-  md.bitrate = enc->target_bitrate;
+  md.bitrate = gst_droidaenc_get_bitrate (enc, droid);
   md.max_input_size = info.bpf * enc->rate;
   enc->codec = droid_media_codec_create_encoder (&md);
 
-  // Reset timestamp clock
-  GstClock *clock = GST_ELEMENT_CLOCK (enc);
-  if (clock) {
-    gst_object_ref (clock);
-    GST_ELEMENT_CAST (enc)->base_time = gst_clock_get_time (clock);
-    gst_object_unref (clock);
-  }
+  enc->samples = 0;
 
   if (!enc->codec) {
     GST_ELEMENT_ERROR (enc, LIBRARY, SETTINGS, NULL,
@@ -154,6 +227,18 @@ gst_droidaenc_create_codec (GstDroidAEnc * enc)
   return TRUE;
 }
 
+static void
+gst_droidaenc_release_input_buffer (void *data)
+{
+  GstDroidAEncBufferReleaseData *release_data =
+      (GstDroidAEncBufferReleaseData *) data;
+
+  gst_buffer_unmap (release_data->buffer, &release_data->info);
+  gst_buffer_unref (release_data->buffer);
+
+  g_slice_free (GstDroidAEncBufferReleaseData, release_data);
+}
+
 static void
 gst_droidaenc_signal_eos (void *data)
 {
@@ -262,6 +347,26 @@ gst_droidaenc_data_available (void *data, DroidMediaCodecData * encoded)
     return;
   }
 
+  if (G_UNLIKELY (!enc->first_frame_sent)) {
+    /* codecs without codec data (AMR) never got their caps set */
+    GST_INFO_OBJECT (enc, "no codec_data received, setting output caps");
+
+    enc->first_frame_sent = TRUE;
+
+    if (!gst_audio_encoder_set_output_format (GST_AUDIO_ENCODER (enc),
+            enc->caps)) {
+      enc->downstream_flow_ret = GST_FLOW_ERROR;
+
+      GST_AUDIO_ENCODER_STREAM_UNLOCK (encoder);
+
+      GST_ELEMENT_ERROR (enc, STREAM, FORMAT, (NULL),
+          ("failed to set output caps"));
+      return;
+    }
+
+    gst_caps_replace (&enc->caps, NULL);
+  }
+
   buffer =
       gst_audio_encoder_allocate_output_buffer (GST_AUDIO_ENCODER (enc),
       encoded->data.size);
@@ -270,13 +375,11 @@ gst_droidaenc_data_available (void *data, DroidMediaCodecData * encoded)
   GST_BUFFER_PTS (buffer) = encoded->ts;
   GST_BUFFER_DTS (buffer) = encoded->decoding_ts;
 
-  /*
-   * 1024 seems to be the number of samples per buffer that Android uses.
-   * It should be fine as long as we have only AAC encoding but should
-   * be revisited if we ever use another audio encoding format
-   */
+  /* android produces one encoded buffer per codec frame and we only ever
+   * queue whole codec frames (see set_format) */
   flow_ret =
-      gst_audio_encoder_finish_frame (GST_AUDIO_ENCODER (enc), buffer, 1024);
+      gst_audio_encoder_finish_frame (GST_AUDIO_ENCODER (enc), buffer,
+      enc->spf != -1 ? enc->spf : 1024);
 
   if (flow_ret == GST_FLOW_OK || flow_ret == GST_FLOW_FLUSHING) {
     goto out;
@@ -375,6 +478,8 @@ gst_droidaenc_start (GstAudioEncoder * encoder)
   enc->downstream_flow_ret = GST_FLOW_OK;
   enc->dirty = TRUE;
   enc->finished = FALSE;
+  enc->samples = 0;
+  enc->pool = gst_droid_bucket_pool_new ();
 
   return TRUE;
 }
@@ -400,6 +505,11 @@ gst_droidaenc_stop (GstAudioEncoder * encoder)
 
   gst_caps_replace (&enc->caps, NULL);
 
+  if (enc->pool) {
+    gst_droid_bucket_pool_free (enc->pool);
+    enc->pool = NULL;
+  }
+
   return TRUE;
 }
 
@@ -425,6 +535,22 @@ gst_droidaenc_set_format (GstAudioEncoder * encoder, GstAudioInfo * info)
     return FALSE;
   }
 
+  /* Let the base class adapter hand us exactly one codec frame at a time
+   * so that each queue call carries a complete encoder frame no matter how
+   * upstream chunks the audio. Only the last buffer before EOS can be short.
+   */
+  GST_INFO_OBJECT (enc, "samples per frame: %d", enc->spf);
+
+  if (enc->spf != -1) {
+    gst_audio_encoder_set_frame_samples_min (encoder, enc->spf);
+    gst_audio_encoder_set_frame_samples_max (encoder, enc->spf);
+    gst_audio_encoder_set_frame_max (encoder, 1);
+  } else {
+    gst_audio_encoder_set_frame_samples_min (encoder, 0);
+    gst_audio_encoder_set_frame_samples_max (encoder, 0);
+    gst_audio_encoder_set_frame_max (encoder, 0);
+  }
+
   /* handle_frame will create the codec */
   enc->dirty = TRUE;
 
@@ -469,8 +595,11 @@ gst_droidaenc_handle_frame (GstAudioEncoder * encoder, GstBuffer * buffer)
   GstDroidAEnc *enc = GST_DROIDAENC (encoder);
   GstFlowReturn ret = GST_FLOW_ERROR;
   DroidMediaCodecData data;
-  GstMapInfo info;
   DroidMediaBufferCallbacks cb;
+  GstDroidAEncBufferReleaseData *release_data;
+  GstAudioInfo *audio_info;
+  GstMapInfo info;
+  GstClockTime ts;
 
   GST_DEBUG_OBJECT (enc, "handle frame");
 
@@ -511,33 +640,46 @@ gst_droidaenc_handle_frame (GstAudioEncoder * encoder, GstBuffer * buffer)
 
   enc->finished = FALSE;
 
-  gst_buffer_map (buffer, &info, GST_MAP_READ);
-  data.data.size = info.size;
-  data.data.data = g_malloc (info.size);
-  data.sync = false;
-
-/* Check if the buffer has a valid timestamp, and if not then set it from the
- * encoder's clock, as some versions of libstagefright throw away frames if
- * it doesn't increase
- */
-  GstClockTime ts = GST_BUFFER_TIMESTAMP (buffer);
-  if (!GST_CLOCK_TIME_IS_VALID (ts)) {
-    GST_DEBUG_OBJECT (enc, "Replacing invalid timestamp: %" GST_TIME_FORMAT,
-        GST_TIME_ARGS (ts));
-    GstClock *clock = gst_element_get_clock (enc);
-    if (clock) {
-      ts = gst_clock_get_time (clock) - GST_ELEMENT_CAST (enc)->base_time;
-      GST_DEBUG_OBJECT (enc, "New timestamp: %" GST_TIME_FORMAT,
-          GST_TIME_ARGS (ts));
-    }
+  if (!gst_buffer_map (buffer, &info, GST_MAP_READ)) {
+    GST_ELEMENT_ERROR (enc, LIBRARY, FAILED, (NULL),
+        ("failed to map input buffer"));
+    goto error;
   }
-  data.ts = GST_TIME_AS_USECONDS (ts);
-  memcpy (data.data.data, info.data, info.size);
 
+  /* The base class wraps its adapter memory which is gone once we return
+   * but droidmedia reads it until it calls us back. Copy it into a recycled
+   * buffer instead of allocating one every time. */
+  release_data = g_slice_new (GstDroidAEncBufferReleaseData);
+  release_data->buffer = gst_droid_bucket_pool_acquire (enc->pool, info.size);
+  gst_buffer_fill (release_data->buffer, 0, info.data, info.size);
   gst_buffer_unmap (buffer, &info);
 
-  cb.unref = g_free;
-  cb.data = data.data.data;
+  if (!gst_buffer_map (release_data->buffer, &release_data->info,
+          GST_MAP_READ)) {
+    gst_buffer_unref (release_data->buffer);
+    g_slice_free (GstDroidAEncBufferReleaseData, release_data);
+    GST_ELEMENT_ERROR (enc, LIBRARY, FAILED, (NULL),
+        ("failed to map input buffer"));
+    goto error;
+  }
+
+  data.data.size = release_data->info.size;
+  data.data.data = release_data->info.data;
+  data.sync = false;
+
+  /* The base class never timestamps its input but some versions of
+   * libstagefright throw away frames if the timestamp does not increase.
+   * Derive it from the number of samples queued so far.
+   */
+  audio_info = gst_audio_encoder_get_audio_info (encoder);
+  ts = gst_util_uint64_scale_int (enc->samples, GST_SECOND,
+      GST_AUDIO_INFO_RATE (audio_info));
+  enc->samples += release_data->info.size / GST_AUDIO_INFO_BPF (audio_info);
+
+  data.ts = GST_TIME_AS_USECONDS (ts);
+
+  cb.unref = gst_droidaenc_release_input_buffer;
+  cb.data = release_data;
 
   /* This can deadlock if droidmedia/stagefright input buffer queue is full thus we
    * cannot write the input buffer. We end up waiting for the write operation
@@ -605,7 +747,10 @@ gst_droidaenc_init (GstDroidAEnc * enc)
   enc->channels = 0;
   enc->rate = 0;
   enc->caps = NULL;
+  enc->spf = -1;
   enc->finished = FALSE;
+  enc->samples = 0;
+  enc->pool = NULL;
 
   g_mutex_init (&enc->eos_lock);
   g_cond_init (&enc->eos_cond);
@@ -653,7 +798,8 @@ gst_droidaenc_class_init (GstDroidAEncClass * klass)
 
   g_object_class_install_property (gobject_class, PROP_TARGET_BITRATE,
       g_param_spec_int ("target-bitrate", "Target Bitrate",
-          "Target bitrate", 0, G_MAXINT,
+          "Target bitrate (AMR uses the closest mode not above it)",
+          0, G_MAXINT,
           GST_DROID_A_ENC_TARGET_BITRATE_DEFAULT,
           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 }
@@ -51,9 +51,17 @@ struct _GstDroidAEnc
   GstCaps *caps;
   gint channels;
   gint rate;
+  gint spf;
 
   gint32 target_bitrate;
 
+  /* queued since the codec got created. protected by encoder stream lock */
+  guint64 samples;
+
+  /* input is copied here because the base class memory does not outlive
+   * handle_frame */
+  GstDroidBucketPool *pool;
+
   /* eos handling */
   gboolean eos;
   GMutex eos_lock;
@@ -0,0 +1,1387 @@
+/*
+ * gst-droid
+ *
+ * Copyright (C) 2015 Jolla LTD.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "gstdroidsimulcastenc.h"
+#include "gst/droid/gstdroidvideoupload.h"
+#include "droidmediaconstants.h"
+#include "plugin.h"
+#include <string.h>
+#include <stdio.h>
+
+GST_DEBUG_CATEGORY_EXTERN (gst_droid_simulcastenc_debug);
+#define GST_CAT_DEFAULT gst_droid_simulcastenc_debug
+
+#define GST_DROIDSIMULCASTENC_EOS_TIMEOUT_SEC          2
+
+#define GST_DROID_SIMULCAST_ENC_BITRATE_DEFAULT 4000000
+#define GST_DROID_SIMULCAST_ENC_KEYFRAME_INTERVAL_DEFAULT 30
+#define GST_DROID_SIMULCAST_ENC_PAD_BITRATE_DEFAULT 0
+
+#define GST_DROIDSIMULCASTENC_LOCK(enc) g_mutex_lock (&(enc)->stream_lock)
+#define GST_DROIDSIMULCASTENC_UNLOCK(enc) g_mutex_unlock (&(enc)->stream_lock)
+
+static GstStaticPadTemplate gst_droidsimulcastenc_sink_template_factory =
+GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS (GST_VIDEO_CAPS_MAKE ("{I420, NV12}")));
+
+enum
+{
+  PROP_0,
+  PROP_BITRATE,
+  PROP_KEYFRAME_INTERVAL,
+};
+
+enum
+{
+  PROP_PAD_0,
+  PROP_PAD_BITRATE,
+};
+
+typedef struct
+{
+  GstBuffer *buffer;
+  GstMapInfo info;
+} GstDroidSimulcastEncReleaseData;
+
+static void gst_droidsimulcastenc_child_proxy_init (gpointer g_iface,
+    gpointer iface_data);
+static void gst_droidsimulcastenc_signal_eos (void *data);
+static void gst_droidsimulcastenc_error (void *data, int err);
+static void gst_droidsimulcastenc_data_available (void *data,
+    DroidMediaCodecData * encoded);
+
+G_DEFINE_TYPE (GstDroidSimulcastEncPad, gst_droidsimulcastenc_pad,
+    GST_TYPE_PAD);
+
+#define gst_droidsimulcastenc_parent_class parent_class
+G_DEFINE_TYPE_WITH_CODE (GstDroidSimulcastEnc, gst_droidsimulcastenc,
+    GST_TYPE_ELEMENT, G_IMPLEMENT_INTERFACE (GST_TYPE_CHILD_PROXY,
+        gst_droidsimulcastenc_child_proxy_init));
+
+static void
+gst_droidsimulcastenc_pad_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstDroidSimulcastEncPad *pad = GST_DROIDSIMULCASTENC_PAD (object);
+
+  switch (prop_id) {
+    case PROP_PAD_BITRATE:
+      GST_OBJECT_LOCK (pad);
+      pad->bitrate = g_value_get_int (value);
+      GST_OBJECT_UNLOCK (pad);
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_droidsimulcastenc_pad_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstDroidSimulcastEncPad *pad = GST_DROIDSIMULCASTENC_PAD (object);
+
+  switch (prop_id) {
+    case PROP_PAD_BITRATE:
+      GST_OBJECT_LOCK (pad);
+      g_value_set_int (value, pad->bitrate);
+      GST_OBJECT_UNLOCK (pad);
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_droidsimulcastenc_pad_finalize (GObject * object)
+{
+  GstDroidSimulcastEncPad *pad = GST_DROIDSIMULCASTENC_PAD (object);
+
+  g_list_free_full (pad->pending_events, (GDestroyNotify) gst_event_unref);
+  pad->pending_events = NULL;
+
+  g_mutex_clear (&pad->eos_lock);
+  g_cond_clear (&pad->eos_cond);
+
+  G_OBJECT_CLASS (gst_droidsimulcastenc_pad_parent_class)->finalize (object);
+}
+
+static void
+gst_droidsimulcastenc_pad_init (GstDroidSimulcastEncPad * pad)
+{
+  pad->bitrate = GST_DROID_SIMULCAST_ENC_PAD_BITRATE_DEFAULT;
+  pad->codec_type = NULL;
+  pad->caps = NULL;
+  pad->codec = NULL;
+  pad->upload_format = GST_VIDEO_FORMAT_UNKNOWN;
+  pad->upload_pool = NULL;
+  pad->pool = NULL;
+  pad->eos = FALSE;
+  pad->flow_ret = GST_FLOW_OK;
+  pad->caps_sent = FALSE;
+  pad->pending_events = NULL;
+  g_mutex_init (&pad->eos_lock);
+  g_cond_init (&pad->eos_cond);
+}
+
+static void
+gst_droidsimulcastenc_pad_class_init (GstDroidSimulcastEncPadClass * klass)
+{
+  GObjectClass *gobject_class = (GObjectClass *) klass;
+
+  gobject_class->finalize = gst_droidsimulcastenc_pad_finalize;
+  gobject_class->set_property = gst_droidsimulcastenc_pad_set_property;
+  gobject_class->get_property = gst_droidsimulcastenc_pad_get_property;
+
+  g_object_class_install_property (gobject_class, PROP_PAD_BITRATE,
+      g_param_spec_int ("bitrate", "Bitrate",
+          "Target bitrate of this rendition "
+          "(0 = element bitrate scaled by picture size)", 0, G_MAXINT,
+          GST_DROID_SIMULCAST_ENC_PAD_BITRATE_DEFAULT,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+}
+
+static void
+gst_droidsimulcastenc_pad_destroy_session (GstDroidSimulcastEncPad * pad)
+{
+  if (pad->codec) {
+    droid_media_codec_stop (pad->codec);
+    droid_media_codec_destroy (pad->codec);
+    pad->codec = NULL;
+  }
+
+  if (pad->upload_pool) {
+    gst_buffer_pool_set_active (pad->upload_pool, FALSE);
+    gst_object_unref (pad->upload_pool);
+    pad->upload_pool = NULL;
+  }
+
+  if (pad->pool) {
+    gst_droid_bucket_pool_free (pad->pool);
+    pad->pool = NULL;
+  }
+}
+
+static void
+gst_droidsimulcastenc_pad_reset (GstDroidSimulcastEncPad * pad)
+{
+  gst_droidsimulcastenc_pad_destroy_session (pad);
+
+  if (pad->codec_type) {
+    gst_droid_codec_unref (pad->codec_type);
+    pad->codec_type = NULL;
+  }
+
+  gst_caps_replace (&pad->caps, NULL);
+
+  GST_OBJECT_LOCK (pad);
+  pad->flow_ret = GST_FLOW_OK;
+  pad->caps_sent = FALSE;
+  pad->key_unit_pending = FALSE;
+  g_list_free_full (pad->pending_events, (GDestroyNotify) gst_event_unref);
+  pad->pending_events = NULL;
+  GST_OBJECT_UNLOCK (pad);
+}
+
+static void
+gst_droidsimulcastenc_pad_push_pending_events (GstDroidSimulcastEncPad * pad,
+    gboolean caps_sent)
+{
+  /*
+   * Pushes the sticky events we held back. Events arriving meanwhile are
+   * queued too so we loop until there are none left and only then let
+   * them through directly by setting caps_sent. This keeps them in order.
+   */
+  GList *events, *l;
+
+  while (TRUE) {
+    GST_OBJECT_LOCK (pad);
+    events = pad->pending_events;
+    pad->pending_events = NULL;
+
+    if (!events) {
+      pad->caps_sent = caps_sent;
+      GST_OBJECT_UNLOCK (pad);
+      break;
+    }
+
+    GST_OBJECT_UNLOCK (pad);
+
+    for (l = events; l; l = l->next) {
+      gst_pad_push_event (GST_PAD (pad), l->data);
+    }
+
+    g_list_free (events);
+  }
+}
+
+static void
+gst_droidsimulcastenc_pad_push_sticky_event (GstDroidSimulcastEncPad * pad,
+    GstEvent * event)
+{
+  /* Our caps go out with the first encoded data. Anything sticky before that
+   * waits so downstream does not see a segment before caps */
+  GST_OBJECT_LOCK (pad);
+  if (!pad->caps_sent) {
+    pad->pending_events = g_list_append (pad->pending_events, event);
+    GST_OBJECT_UNLOCK (pad);
+    return;
+  }
+  GST_OBJECT_UNLOCK (pad);
+
+  gst_pad_push_event (GST_PAD (pad), event);
+}
+
+static gboolean
+gst_droidsimulcastenc_pad_negotiate (GstDroidSimulcastEnc * enc,
+    GstDroidSimulcastEncPad * pad)
+{
+  GstCaps *caps;
+  GstCaps *tpl;
+  GstStructure *s;
+  gint width, height;
+  gint32 bitrate;
+
+  tpl = gst_pad_get_pad_template_caps (GST_PAD (pad));
+  caps = gst_pad_peer_query_caps (GST_PAD (pad), tpl);
+  gst_caps_unref (tpl);
+
+  GST_LOG_OBJECT (pad, "peer caps %" GST_PTR_FORMAT, caps);
+
+  if (gst_caps_is_empty (caps)) {
+    GST_ELEMENT_ERROR (enc, STREAM, FORMAT, (NULL),
+        ("downstream of %s does not accept any of our formats",
+            GST_PAD_NAME (pad)));
+    gst_caps_unref (caps);
+    return FALSE;
+  }
+
+  /* Renditions default to the input size. Downstream restricts them. */
+  caps = gst_caps_truncate (caps);
+  s = gst_caps_get_structure (caps, 0);
+
+  if (gst_structure_has_field (s, "width")) {
+    gst_structure_fixate_field_nearest_int (s, "width", enc->info.width);
+  } else {
+    gst_structure_set (s, "width", G_TYPE_INT, enc->info.width, NULL);
+  }
+
+  if (gst_structure_has_field (s, "height")) {
+    gst_structure_fixate_field_nearest_int (s, "height", enc->info.height);
+  } else {
+    gst_structure_set (s, "height", G_TYPE_INT, enc->info.height, NULL);
+  }
+
+  gst_structure_set (s, "framerate", GST_TYPE_FRACTION, enc->info.fps_n,
+      enc->info.fps_d, NULL);
+
+  caps = gst_caps_fixate (caps);
+  s = gst_caps_get_structure (caps, 0);
+
+  gst_structure_get_int (s, "width", &width);
+  gst_structure_get_int (s, "height", &height);
+
+  if (width > enc->info.width || height > enc->info.height) {
+    GST_ELEMENT_ERROR (enc, STREAM, FORMAT, (NULL),
+        ("rendition %s (%dx%d) is bigger than the input (%dx%d)",
+            GST_PAD_NAME (pad), width, height, enc->info.width,
+            enc->info.height));
+    gst_caps_unref (caps);
+    return FALSE;
+  }
+
+  /* 4:2:0 */
+  if (width % 2 || height % 2) {
+    width = GST_ROUND_DOWN_2 (width);
+    height = GST_ROUND_DOWN_2 (height);
+    gst_structure_set (s, "width", G_TYPE_INT, width, "height", G_TYPE_INT,
+        height, NULL);
+  }
+
+  pad->codec_type =
+      gst_droid_codec_new_from_caps (caps, GST_DROID_CODEC_ENCODER_VIDEO);
+  if (!pad->codec_type) {
+    GST_ELEMENT_ERROR (enc, LIBRARY, FAILED, (NULL),
+        ("Unknown codec type for caps %" GST_PTR_FORMAT, caps));
+    gst_caps_unref (caps);
+    return FALSE;
+  }
+
+  gst_droid_codec_complement_caps (pad->codec_type, caps);
+
+  GST_OBJECT_LOCK (enc);
+  bitrate = enc->bitrate;
+  GST_OBJECT_UNLOCK (enc);
+
+  GST_OBJECT_LOCK (pad);
+  pad->target_bitrate = pad->bitrate;
+  GST_OBJECT_UNLOCK (pad);
+
+  if (pad->target_bitrate == 0) {
+    pad->target_bitrate = (gint64) bitrate * width * height /
+        ((gint64) enc->info.width * enc->info.height);
+  }
+
+  pad->width = width;
+  pad->height = height;
+  pad->caps = caps;
+
+  GST_INFO_OBJECT (pad, "rendition %dx%d at %d bps, caps %" GST_PTR_FORMAT,
+      width, height, pad->target_bitrate, caps);
+
+  GST_OBJECT_LOCK (pad);
+  pad->caps_sent = FALSE;
+  GST_OBJECT_UNLOCK (pad);
+
+  /* The caps are set once the encoder hands us codec_data. avc caps without
+   * it are not valid */
+  return gst_pad_peer_query_accept_caps (GST_PAD (pad), caps);
+}
+
+static gboolean
+gst_droidsimulcastenc_pad_create_session (GstDroidSimulcastEnc * enc,
+    GstDroidSimulcastEncPad * pad)
+{
+  DroidMediaCodecEncoderMetaData md;
+  DroidMediaColourFormatConstants constants;
+  GstStructure *config;
+  guint keyframe_interval;
+  const gchar *droid = gst_droid_codec_get_droid_type (pad->codec_type);
+
+  memset (&md, 0x0, sizeof (md));
+
+  droid_media_colour_format_constants_init (&constants);
+
+  if (pad->codec_type->quirks & USE_PLANAR_INPUT_VALUE) {
+    pad->upload_format = GST_VIDEO_FORMAT_I420;
+    md.color_format = constants.OMX_COLOR_FormatYUV420Planar;
+  } else {
+    pad->upload_format = GST_VIDEO_FORMAT_NV12;
+    md.color_format = constants.OMX_COLOR_FormatYUV420SemiPlanar;
+  }
+
+  pad->stride = GST_ROUND_UP_16 (pad->width);
+  pad->slice_height = GST_ROUND_UP_16 (pad->height);
+
+  md.parent.type = droid;
+  md.parent.width = pad->width;
+  md.parent.height = pad->height;
+  md.parent.fps = enc->info.fps_n / enc->info.fps_d;
+  md.parent.flags = DROID_MEDIA_CODEC_HW_ONLY;
+  md.bitrate = pad->target_bitrate;
+  md.stride = pad->stride;
+  md.slice_height = pad->slice_height;
+  md.meta_data = false;
+
+#if defined (HAVE_DROIDMEDIACODECENCODERMETADATA_PROFILE) && defined (HAVE_DROIDMEDIACODECENCODERMETADATA_LEVEL)
+  {
+    gint profile, level;
+
+    gst_droid_codec_get_profile_level (pad->codec_type, &profile, &level);
+    md.profile = profile;
+    md.level = level;
+  }
+#endif
+
+  GST_OBJECT_LOCK (enc);
+  keyframe_interval = enc->keyframe_interval;
+  GST_OBJECT_UNLOCK (enc);
+
+#ifdef HAVE_DROIDMEDIACODECENCODERMETADATA_I_FRAME_INTERVAL
+#if HAVE_DECL_DROID_MEDIA_CODEC_REQUEST_SYNC_FRAME
+  /* We request all keyframes ourselves so they line up across renditions */
+  md.i_frame_interval = -1;
+#else
+  /* Best effort: all sessions see the same frames with the same GOP length */
+  md.i_frame_interval = enc->info.fps_n ?
+      MAX (1, gst_util_uint64_scale_int_round (keyframe_interval,
+          enc->info.fps_d, enc->info.fps_n)) : 1;
+#endif
+#endif
+
+  GST_INFO_OBJECT (pad,
+      "create codec of type: %s resolution: %dx%d bitrate: %d "
+      "keyframe interval: %u", droid, pad->width, pad->height, md.bitrate,
+      keyframe_interval);
+
+  pad->upload_pool = gst_buffer_pool_new ();
+  config = gst_buffer_pool_get_config (pad->upload_pool);
+  gst_buffer_pool_config_set_params (config, NULL,
+      gst_droid_video_upload_get_size (pad->upload_format, pad->stride,
+          pad->slice_height), 0, 0);
+
+  if (!gst_buffer_pool_set_config (pad->upload_pool, config)
+      || !gst_buffer_pool_set_active (pad->upload_pool, TRUE)) {
+    GST_ELEMENT_ERROR (enc, RESOURCE, NO_SPACE_LEFT, (NULL),
+        ("Failed to create upload buffer pool"));
+    goto error;
+  }
+
+  pad->pool = gst_droid_bucket_pool_new ();
+
+  pad->codec = droid_media_codec_create_encoder (&md);
+  if (!pad->codec) {
+    GST_ELEMENT_ERROR (enc, LIBRARY, SETTINGS, NULL,
+        ("Failed to create encoder for %s", GST_PAD_NAME (pad)));
+    goto error;
+  }
+
+  {
+    DroidMediaCodecCallbacks cb;
+    cb.signal_eos = gst_droidsimulcastenc_signal_eos;
+    cb.error = gst_droidsimulcastenc_error;
+    droid_media_codec_set_callbacks (pad->codec, &cb, pad);
+  }
+
+  {
+    DroidMediaCodecDataCallbacks cb;
+    cb.data_available = gst_droidsimulcastenc_data_available;
+    droid_media_codec_set_data_callbacks (pad->codec, &cb, pad);
+  }
+
+  if (!droid_media_codec_start (pad->codec)) {
+    GST_ELEMENT_ERROR (enc, LIBRARY, INIT, (NULL),
+        ("Failed to start the encoder for %s", GST_PAD_NAME (pad)));
+
+    droid_media_codec_destroy (pad->codec);
+    pad->codec = NULL;
+    goto error;
+  }
+
+  return TRUE;
+
+error:
+  gst_droidsimulcastenc_pad_destroy_session (pad);
+  return FALSE;
+}
+
+static void
+gst_droidsimulcastenc_signal_eos (void *data)
+{
+  GstDroidSimulcastEncPad *pad = (GstDroidSimulcastEncPad *) data;
+
+  GST_DEBUG_OBJECT (pad, "codec signaled EOS");
+
+  g_mutex_lock (&pad->eos_lock);
+
+  if (!pad->eos) {
+    GST_WARNING_OBJECT (pad, "codec signaled EOS but we are not expecting it");
+  }
+
+  pad->eos = FALSE;
+  g_cond_signal (&pad->eos_cond);
+  g_mutex_unlock (&pad->eos_lock);
+}
+
+static void
+gst_droidsimulcastenc_error (void *data, int err)
+{
+  GstDroidSimulcastEncPad *pad = (GstDroidSimulcastEncPad *) data;
+  GstElement *enc = GST_PAD_PARENT (pad);
+
+  GST_DEBUG_OBJECT (pad, "codec error");
+
+  g_mutex_lock (&pad->eos_lock);
+
+  if (pad->eos) {
+    /* We will ignore errors if we are expecting EOS */
+    pad->eos = FALSE;
+    g_cond_signal (&pad->eos_cond);
+    goto out;
+  }
+
+  GST_OBJECT_LOCK (pad);
+  pad->flow_ret = GST_FLOW_ERROR;
+  GST_OBJECT_UNLOCK (pad);
+
+  GST_ELEMENT_ERROR (enc, LIBRARY, FAILED, NULL,
+      ("error 0x%x from android codec for %s", -err, GST_PAD_NAME (pad)));
+
+out:
+  g_mutex_unlock (&pad->eos_lock);
+}
+
+static void
+gst_droidsimulcastenc_data_available (void *data,
+    DroidMediaCodecData * encoded)
+{
+  GstDroidSimulcastEncPad *pad = (GstDroidSimulcastEncPad *) data;
+  GstElement *enc = GST_PAD_PARENT (pad);
+  GstBuffer *buffer;
+  GstEvent *key_unit = NULL;
+  GstFlowReturn flow_ret;
+  gboolean send_caps;
+
+  GST_DEBUG_OBJECT (pad, "data available");
+
+  if (encoded->codec_config) {
+    GstBuffer *codec_data;
+    GstCaps *caps;
+    gboolean ret;
+
+    GST_INFO_OBJECT (pad, "received codec_data");
+
+    codec_data =
+        gst_droid_codec_create_encoder_codec_data (pad->codec_type,
+        &encoded->data);
+
+    if (!codec_data) {
+      flow_ret = GST_FLOW_ERROR;
+      GST_ELEMENT_ERROR (enc, STREAM, FORMAT, (NULL),
+          ("Failed to construct codec_data. Expect corrupted stream"));
+      goto out;
+    }
+
+    caps = gst_caps_copy (pad->caps);
+    gst_caps_set_simple (caps, "codec_data", GST_TYPE_BUFFER, codec_data, NULL);
+    gst_buffer_unref (codec_data);
+
+    ret = gst_pad_set_caps (GST_PAD (pad), caps);
+    gst_caps_unref (caps);
+
+    if (!ret) {
+      flow_ret = GST_FLOW_NOT_NEGOTIATED;
+      GST_ELEMENT_ERROR (enc, STREAM, FORMAT, (NULL),
+          ("Failed to set caps on %s", GST_PAD_NAME (pad)));
+      goto out;
+    }
+
+    gst_droidsimulcastenc_pad_push_pending_events (pad, TRUE);
+
+    return;
+  }
+
+  /* Only we set caps_sent so we can check without holding the lock for long */
+  GST_OBJECT_LOCK (pad);
+  send_caps = !pad->caps_sent;
+  GST_OBJECT_UNLOCK (pad);
+
+  /* codecs without codec_data */
+  if (send_caps) {
+    if (!gst_pad_set_caps (GST_PAD (pad), pad->caps)) {
+      flow_ret = GST_FLOW_NOT_NEGOTIATED;
+      GST_ELEMENT_ERROR (enc, STREAM, FORMAT, (NULL),
+          ("Failed to set caps on %s", GST_PAD_NAME (pad)));
+      goto out;
+    }
+
+    gst_droidsimulcastenc_pad_push_pending_events (pad, TRUE);
+  }
+
+  buffer =
+      gst_droid_codec_prepare_encoded_data (pad->codec_type, &encoded->data,
+      pad->pool);
+  if (!buffer) {
+    flow_ret = GST_FLOW_ERROR;
+    GST_ELEMENT_ERROR (enc, LIBRARY, ENCODE, (NULL),
+        ("failed to process encoded data"));
+    goto out;
+  }
+
+  GST_BUFFER_PTS (buffer) = encoded->ts;
+  GST_BUFFER_DTS (buffer) = encoded->decoding_ts;
+
+  if (encoded->sync) {
+    GST_BUFFER_FLAG_UNSET (buffer, GST_BUFFER_FLAG_DELTA_UNIT);
+
+    GST_OBJECT_LOCK (pad);
+    if (pad->key_unit_pending) {
+      key_unit =
+          gst_video_event_new_downstream_force_key_unit (GST_BUFFER_PTS
+          (buffer), GST_CLOCK_TIME_NONE, pad->key_unit_running_time,
+          pad->key_unit_all_headers, pad->key_unit_count);
+      pad->key_unit_pending = FALSE;
+    }
+    GST_OBJECT_UNLOCK (pad);
+  } else {
+    GST_BUFFER_FLAG_SET (buffer, GST_BUFFER_FLAG_DELTA_UNIT);
+  }
+
+  /* tell downstream the requested keyframe is here */
+  if (key_unit) {
+    GST_DEBUG_OBJECT (pad, "answering key unit request");
+    gst_pad_push_event (GST_PAD (pad), key_unit);
+  }
+
+  flow_ret = gst_pad_push (GST_PAD (pad), buffer);
+
+  if (flow_ret < GST_FLOW_OK && flow_ret != GST_FLOW_FLUSHING
+      && flow_ret != GST_FLOW_EOS && flow_ret != GST_FLOW_NOT_LINKED) {
+    GST_ELEMENT_ERROR (enc, STREAM, FAILED,
+        ("Internal data stream error."), ("stream stopped, reason %s",
+            gst_flow_get_name (flow_ret)));
+  }
+
+out:
+  GST_OBJECT_LOCK (pad);
+  pad->flow_ret = flow_ret;
+  GST_OBJECT_UNLOCK (pad);
+}
+
+static void
+gst_droidsimulcastenc_release_input (void *data)
+{
+  GstDroidSimulcastEncReleaseData *release_data =
+      (GstDroidSimulcastEncReleaseData *) data;
+
+  gst_buffer_unmap (release_data->buffer, &release_data->info);
+  gst_buffer_unref (release_data->buffer);
+
+  g_slice_free (GstDroidSimulcastEncReleaseData, release_data);
+}
+
+static gboolean
+gst_droidsimulcastenc_pad_queue (GstDroidSimulcastEnc * enc,
+    GstDroidSimulcastEncPad * pad, GstVideoFrame * frame, GstClockTime pts,
+    gboolean keyframe)
+{
+  DroidMediaCodecData data;
+  DroidMediaBufferCallbacks cb;
+  GstDroidSimulcastEncReleaseData *release_data;
+  GstBuffer *buffer = NULL;
+
+  if (gst_buffer_pool_acquire_buffer (pad->upload_pool, &buffer,
+          NULL) != GST_FLOW_OK) {
+    GST_ERROR_OBJECT (pad, "failed to acquire upload buffer");
+    return FALSE;
+  }
+
+  release_data = g_slice_new (GstDroidSimulcastEncReleaseData);
+  release_data->buffer = buffer;
+  gst_buffer_map (buffer, &release_data->info, GST_MAP_READWRITE);
+
+  if (!gst_droid_video_upload_scaled (frame, release_data->info.data,
+          pad->upload_format, pad->width, pad->height, pad->stride,
+          pad->slice_height)) {
+    gst_droidsimulcastenc_release_input (release_data);
+    return FALSE;
+  }
+
+  if (keyframe) {
+#if HAVE_DECL_DROID_MEDIA_CODEC_REQUEST_SYNC_FRAME
+    droid_media_codec_request_sync_frame (pad->codec);
+#endif
+  }
+
+  data.sync = false;
+  data.ts = GST_TIME_AS_USECONDS (pts);
+  data.data.size = release_data->info.size;
+  data.data.data = release_data->info.data;
+
+  cb.unref = gst_droidsimulcastenc_release_input;
+  cb.data = release_data;
+
+  droid_media_codec_queue (pad->codec, &data, &cb);
+
+  return TRUE;
+}
+
+static GstFlowReturn
+gst_droidsimulcastenc_combine_flows (GstDroidSimulcastEnc * enc)
+{
+  GList *l;
+  gboolean all_eos = TRUE;
+  gboolean all_not_linked = TRUE;
+
+  if (!enc->srcpads) {
+    return GST_FLOW_NOT_LINKED;
+  }
+
+  for (l = enc->srcpads; l; l = l->next) {
+    GstDroidSimulcastEncPad *pad = l->data;
+    GstFlowReturn ret;
+
+    GST_OBJECT_LOCK (pad);
+    ret = pad->flow_ret;
+    GST_OBJECT_UNLOCK (pad);
+
+    if (ret == GST_FLOW_FLUSHING || ret <= GST_FLOW_NOT_NEGOTIATED) {
+      return ret;
+    }
+
+    if (ret != GST_FLOW_EOS) {
+      all_eos = FALSE;
+    }
+
+    if (ret != GST_FLOW_NOT_LINKED) {
+      all_not_linked = FALSE;
+    }
+  }
+
+  if (all_eos) {
+    return GST_FLOW_EOS;
+  }
+
+  if (all_not_linked) {
+    return GST_FLOW_NOT_LINKED;
+  }
+
+  return GST_FLOW_OK;
+}
+
+static void
+gst_droidsimulcastenc_drain (GstDroidSimulcastEnc * enc)
+{
+  GList *l;
+  GTimeVal tv;
+
+  GST_DEBUG_OBJECT (enc, "drain");
+
+  /* Drain all encoders at once then wait for them */
+  for (l = enc->srcpads; l; l = l->next) {
+    GstDroidSimulcastEncPad *pad = l->data;
+
+    if (pad->codec) {
+      g_mutex_lock (&pad->eos_lock);
+      pad->eos = TRUE;
+      droid_media_codec_drain (pad->codec);
+      g_mutex_unlock (&pad->eos_lock);
+    }
+  }
+
+  g_get_current_time (&tv);
+  g_time_val_add (&tv, G_USEC_PER_SEC * GST_DROIDSIMULCASTENC_EOS_TIMEOUT_SEC);
+
+  for (l = enc->srcpads; l; l = l->next) {
+    GstDroidSimulcastEncPad *pad = l->data;
+
+    if (!pad->codec) {
+      continue;
+    }
+
+    g_mutex_lock (&pad->eos_lock);
+    /* We cannot wait forever because sometimes we never hear anything
+     * from the video encoders. */
+    while (pad->eos) {
+      if (!g_cond_timed_wait (&pad->eos_cond, &pad->eos_lock, &tv)) {
+        GST_WARNING_OBJECT (pad, "timeout waiting for eos");
+        break;
+      }
+    }
+
+    pad->eos = FALSE;
+    g_mutex_unlock (&pad->eos_lock);
+
+    gst_droidsimulcastenc_pad_destroy_session (pad);
+  }
+
+  enc->dirty = TRUE;
+  enc->frames_since_keyframe = 0;
+}
+
+static gboolean
+gst_droidsimulcastenc_set_caps (GstDroidSimulcastEnc * enc, GstCaps * caps)
+{
+  GstVideoInfo info;
+  GList *l;
+  gboolean ret = TRUE;
+
+  GST_DEBUG_OBJECT (enc, "set caps %" GST_PTR_FORMAT, caps);
+
+  if (!gst_video_info_from_caps (&info, caps)) {
+    GST_ERROR_OBJECT (enc, "failed to parse caps %" GST_PTR_FORMAT, caps);
+    return FALSE;
+  }
+
+  GST_DROIDSIMULCASTENC_LOCK (enc);
+
+  /* Don't lose what the encoders still hold */
+  gst_droidsimulcastenc_drain (enc);
+
+  enc->info = info;
+  enc->have_info = TRUE;
+
+  for (l = enc->srcpads; l; l = l->next) {
+    GstDroidSimulcastEncPad *pad = l->data;
+
+    gst_droidsimulcastenc_pad_reset (pad);
+
+    if (!gst_droidsimulcastenc_pad_negotiate (enc, pad)) {
+      ret = FALSE;
+      break;
+    }
+  }
+
+  GST_DROIDSIMULCASTENC_UNLOCK (enc);
+
+  return ret;
+}
+
+static gboolean
+gst_droidsimulcastenc_stream_start (GstDroidSimulcastEnc * enc,
+    GstEvent * event)
+{
+  GList *l;
+  guint group_id;
+  gboolean have_group_id;
+  gboolean ret = TRUE;
+
+  have_group_id = gst_event_parse_group_id (event, &group_id);
+
+  GST_DROIDSIMULCASTENC_LOCK (enc);
+
+  /* Each rendition is its own stream */
+  for (l = enc->srcpads; l; l = l->next) {
+    GstPad *pad = l->data;
+    gchar *stream_id =
+        gst_pad_create_stream_id (pad, GST_ELEMENT (enc), GST_PAD_NAME (pad));
+    GstEvent *ev = gst_event_new_stream_start (stream_id);
+
+    if (have_group_id) {
+      gst_event_set_group_id (ev, group_id);
+    }
+
+    ret &= gst_pad_push_event (pad, ev);
+    g_free (stream_id);
+  }
+
+  GST_DROIDSIMULCASTENC_UNLOCK (enc);
+
+  gst_event_unref (event);
+
+  return ret;
+}
+
+static gboolean
+gst_droidsimulcastenc_sink_event (GstPad * pad, GstObject * parent,
+    GstEvent * event)
+{
+  GstDroidSimulcastEnc *enc = GST_DROIDSIMULCASTENC (parent);
+  GList *l;
+
+  GST_DEBUG_OBJECT (enc, "event %" GST_PTR_FORMAT, event);
+
+  switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_CAPS:
+    {
+      GstCaps *caps;
+      gboolean ret;
+
+      gst_event_parse_caps (event, &caps);
+      ret = gst_droidsimulcastenc_set_caps (enc, caps);
+      gst_event_unref (event);
+      return ret;
+    }
+
+    case GST_EVENT_STREAM_START:
+      return gst_droidsimulcastenc_stream_start (enc, event);
+
+    case GST_EVENT_EOS:
+      GST_DROIDSIMULCASTENC_LOCK (enc);
+      gst_droidsimulcastenc_drain (enc);
+
+      /* renditions which never produced data still need their segment */
+      for (l = enc->srcpads; l; l = l->next) {
+        GstDroidSimulcastEncPad *srcpad = l->data;
+        gboolean caps_sent;
+
+        GST_OBJECT_LOCK (srcpad);
+        caps_sent = srcpad->caps_sent;
+        GST_OBJECT_UNLOCK (srcpad);
+
+        gst_droidsimulcastenc_pad_push_pending_events (srcpad, caps_sent);
+      }
+
+      GST_DROIDSIMULCASTENC_UNLOCK (enc);
+      break;
+
+    case GST_EVENT_FLUSH_STOP:
+      GST_DROIDSIMULCASTENC_LOCK (enc);
+      for (l = enc->srcpads; l; l = l->next) {
+        GstDroidSimulcastEncPad *srcpad = l->data;
+
+        gst_droidsimulcastenc_pad_destroy_session (srcpad);
+
+        /* a new segment follows */
+        GST_OBJECT_LOCK (srcpad);
+        srcpad->flow_ret = GST_FLOW_OK;
+        g_list_free_full (srcpad->pending_events,
+            (GDestroyNotify) gst_event_unref);
+        srcpad->pending_events = NULL;
+        GST_OBJECT_UNLOCK (srcpad);
+      }
+
+      enc->dirty = TRUE;
+      enc->frames_since_keyframe = 0;
+      GST_DROIDSIMULCASTENC_UNLOCK (enc);
+      break;
+
+    case GST_EVENT_CUSTOM_DOWNSTREAM:
+      if (gst_video_event_is_force_key_unit (event)) {
+        GST_OBJECT_LOCK (enc);
+        enc->force_keyframe = TRUE;
+        GST_OBJECT_UNLOCK (enc);
+      }
+      break;
+
+    default:
+      if (GST_EVENT_IS_STICKY (event)) {
+        GST_DROIDSIMULCASTENC_LOCK (enc);
+        for (l = enc->srcpads; l; l = l->next) {
+          gst_droidsimulcastenc_pad_push_sticky_event (l->data,
+              gst_event_ref (event));
+        }
+        GST_DROIDSIMULCASTENC_UNLOCK (enc);
+
+        gst_event_unref (event);
+        return TRUE;
+      }
+      break;
+  }
+
+  return gst_pad_event_default (pad, parent, event);
+}
+
+static gboolean
+gst_droidsimulcastenc_src_event (GstPad * pad, GstObject * parent,
+    GstEvent * event)
+{
+  GstDroidSimulcastEnc *enc = GST_DROIDSIMULCASTENC (parent);
+  GstClockTime running_time;
+  gboolean all_headers;
+  guint count;
+  GList *l;
+
+  if (gst_video_event_is_force_key_unit (event)
+      && gst_video_event_parse_upstream_force_key_unit (event, &running_time,
+          &all_headers, &count)) {
+    /* A keyframe for one rendition is a keyframe for all of them. Each pad
+     * answers with a downstream key unit event in front of it */
+    GST_DEBUG_OBJECT (pad, "keyframe requested");
+
+    GST_OBJECT_LOCK (enc);
+    enc->force_keyframe = TRUE;
+
+    for (l = enc->srcpads; l; l = l->next) {
+      GstDroidSimulcastEncPad *srcpad = l->data;
+
+      GST_OBJECT_LOCK (srcpad);
+      srcpad->key_unit_pending = TRUE;
+      srcpad->key_unit_running_time = running_time;
+      srcpad->key_unit_all_headers = all_headers;
+      srcpad->key_unit_count = count;
+      GST_OBJECT_UNLOCK (srcpad);
+    }
+
+    GST_OBJECT_UNLOCK (enc);
+
+    gst_event_unref (event);
+    return TRUE;
+  }
+
+  return gst_pad_event_default (pad, parent, event);
+}
+
+static GstFlowReturn
+gst_droidsimulcastenc_chain (GstPad * sinkpad, GstObject * parent,
+    GstBuffer * buffer)
+{
+  GstDroidSimulcastEnc *enc = GST_DROIDSIMULCASTENC (parent);
+  GstFlowReturn ret;
+  GstVideoFrame frame;
+  gboolean keyframe;
+  GList *l;
+
+  GST_DROIDSIMULCASTENC_LOCK (enc);
+
+  ret = gst_droidsimulcastenc_combine_flows (enc);
+  if (ret != GST_FLOW_OK) {
+    GST_DEBUG_OBJECT (enc, "not handling frame: %s", gst_flow_get_name (ret));
+    goto out;
+  }
+
+  if (G_UNLIKELY (!enc->have_info)) {
+    GST_ELEMENT_ERROR (enc, CORE, NEGOTIATION, (NULL),
+        ("received a buffer before caps"));
+    ret = GST_FLOW_NOT_NEGOTIATED;
+    goto out;
+  }
+
+  /* Now we create the actual codecs */
+  if (G_UNLIKELY (enc->dirty)) {
+    for (l = enc->srcpads; l; l = l->next) {
+      GstDroidSimulcastEncPad *pad = l->data;
+
+      if (pad->codec_type && !pad->codec
+          && !gst_droidsimulcastenc_pad_create_session (enc, pad)) {
+        ret = GST_FLOW_ERROR;
+        goto out;
+      }
+    }
+
+    enc->dirty = FALSE;
+  }
+
+  GST_OBJECT_LOCK (enc);
+  keyframe = enc->force_keyframe || (enc->keyframe_interval
+      && enc->frames_since_keyframe >= enc->keyframe_interval);
+  enc->force_keyframe = FALSE;
+  GST_OBJECT_UNLOCK (enc);
+
+  /* The first frame is always a keyframe. No need to ask for it. */
+  if (enc->frames_since_keyframe == 0) {
+    keyframe = FALSE;
+  } else if (keyframe) {
+    GST_DEBUG_OBJECT (enc, "requesting keyframe from all renditions");
+    enc->frames_since_keyframe = 0;
+  }
+
+  ++enc->frames_since_keyframe;
+
+  /* We map the input once and scale from it for every rendition */
+  if (!gst_video_frame_map (&frame, &enc->info, buffer, GST_MAP_READ)) {
+    GST_ELEMENT_ERROR (enc, STREAM, FORMAT, (NULL),
+        ("Failed to map input frame"));
+    ret = GST_FLOW_ERROR;
+    goto out;
+  }
+
+  for (l = enc->srcpads; l; l = l->next) {
+    GstDroidSimulcastEncPad *pad = l->data;
+
+    if (!pad->codec) {
+      continue;
+    }
+
+    if (!gst_droidsimulcastenc_pad_queue (enc, pad, &frame,
+            GST_BUFFER_PTS (buffer), keyframe)) {
+      GST_ELEMENT_ERROR (enc, STREAM, FORMAT, (NULL),
+          ("Failed to upload input frame for %s", GST_PAD_NAME (pad)));
+      ret = GST_FLOW_ERROR;
+      break;
+    }
+  }
+
+  gst_video_frame_unmap (&frame);
+
+out:
+  GST_DROIDSIMULCASTENC_UNLOCK (enc);
+
+  gst_buffer_unref (buffer);
+
+  return ret;
+}
+
+static GstPad *
+gst_droidsimulcastenc_request_new_pad (GstElement * element,
+    GstPadTemplate * templ, const gchar * name, const GstCaps * caps)
+{
+  GstDroidSimulcastEnc *enc = GST_DROIDSIMULCASTENC (element);
+  GstPad *pad;
+  gchar *pad_name;
+  guint id;
+  GstState state;
+
+  GST_OBJECT_LOCK (enc);
+  state = GST_STATE (enc);
+  GST_OBJECT_UNLOCK (enc);
+
+  if (state > GST_STATE_READY) {
+    GST_WARNING_OBJECT (enc, "renditions can only be added in NULL or READY");
+    return NULL;
+  }
+
+  GST_DROIDSIMULCASTENC_LOCK (enc);
+  GST_OBJECT_LOCK (enc);
+
+  if (name && sscanf (name, "src_%u", &id) == 1) {
+    enc->next_pad_id = MAX (enc->next_pad_id, id + 1);
+    pad_name = g_strdup (name);
+  } else {
+    pad_name = g_strdup_printf ("src_%u", enc->next_pad_id++);
+  }
+
+  GST_OBJECT_UNLOCK (enc);
+
+  pad = g_object_new (GST_TYPE_DROIDSIMULCASTENC_PAD, "name", pad_name,
+      "direction", GST_PAD_SRC, "template", templ, NULL);
+  g_free (pad_name);
+
+  gst_pad_set_event_function (pad,
+      GST_DEBUG_FUNCPTR (gst_droidsimulcastenc_src_event));
+
+  GST_OBJECT_LOCK (enc);
+  enc->srcpads = g_list_append (enc->srcpads, pad);
+  GST_OBJECT_UNLOCK (enc);
+
+  GST_DROIDSIMULCASTENC_UNLOCK (enc);
+
+  GST_DEBUG_OBJECT (enc, "added rendition %s", GST_PAD_NAME (pad));
+
+  gst_element_add_pad (element, pad);
+  gst_child_proxy_child_added (GST_CHILD_PROXY (enc), G_OBJECT (pad),
+      GST_OBJECT_NAME (pad));
+
+  return pad;
+}
+
+static void
+gst_droidsimulcastenc_release_pad (GstElement * element, GstPad * pad)
+{
+  GstDroidSimulcastEnc *enc = GST_DROIDSIMULCASTENC (element);
+
+  GST_DEBUG_OBJECT (enc, "releasing rendition %s", GST_PAD_NAME (pad));
+
+  GST_DROIDSIMULCASTENC_LOCK (enc);
+
+  gst_droidsimulcastenc_pad_reset (GST_DROIDSIMULCASTENC_PAD (pad));
+
+  GST_OBJECT_LOCK (enc);
+  enc->srcpads = g_list_remove (enc->srcpads, pad);
+  GST_OBJECT_UNLOCK (enc);
+
+  GST_DROIDSIMULCASTENC_UNLOCK (enc);
+
+  gst_child_proxy_child_removed (GST_CHILD_PROXY (enc), G_OBJECT (pad),
+      GST_OBJECT_NAME (pad));
+  gst_element_remove_pad (element, pad);
+}
+
+static GstStateChangeReturn
+gst_droidsimulcastenc_change_state (GstElement * element,
+    GstStateChange transition)
+{
+  GstDroidSimulcastEnc *enc = GST_DROIDSIMULCASTENC (element);
+  GstStateChangeReturn ret;
+  GList *l;
+
+  GST_DEBUG_OBJECT (enc, "state change %s -> %s",
+      gst_element_state_get_name (GST_STATE_TRANSITION_CURRENT (transition)),
+      gst_element_state_get_name (GST_STATE_TRANSITION_NEXT (transition)));
+
+  ret = GST_ELEMENT_CLASS (parent_class)->change_state (element, transition);
+  if (ret == GST_STATE_CHANGE_FAILURE) {
+    return ret;
+  }
+
+  if (transition == GST_STATE_CHANGE_PAUSED_TO_READY) {
+    GST_DROIDSIMULCASTENC_LOCK (enc);
+
+    for (l = enc->srcpads; l; l = l->next) {
+      gst_droidsimulcastenc_pad_reset (l->data);
+    }
+
+    enc->have_info = FALSE;
+    enc->dirty = TRUE;
+    enc->frames_since_keyframe = 0;
+
+    GST_OBJECT_LOCK (enc);
+    enc->force_keyframe = FALSE;
+    GST_OBJECT_UNLOCK (enc);
+
+    GST_DROIDSIMULCASTENC_UNLOCK (enc);
+  }
+
+  return ret;
+}
+
+static void
+gst_droidsimulcastenc_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstDroidSimulcastEnc *enc = GST_DROIDSIMULCASTENC (object);
+
+  switch (prop_id) {
+    case PROP_BITRATE:
+      GST_OBJECT_LOCK (enc);
+      enc->bitrate = g_value_get_int (value);
+      GST_OBJECT_UNLOCK (enc);
+      break;
+
+    case PROP_KEYFRAME_INTERVAL:
+      GST_OBJECT_LOCK (enc);
+      enc->keyframe_interval = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (enc);
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_droidsimulcastenc_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstDroidSimulcastEnc *enc = GST_DROIDSIMULCASTENC (object);
+
+  switch (prop_id) {
+    case PROP_BITRATE:
+      GST_OBJECT_LOCK (enc);
+      g_value_set_int (value, enc->bitrate);
+      GST_OBJECT_UNLOCK (enc);
+      break;
+
+    case PROP_KEYFRAME_INTERVAL:
+      GST_OBJECT_LOCK (enc);
+      g_value_set_uint (value, enc->keyframe_interval);
+      GST_OBJECT_UNLOCK (enc);
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_droidsimulcastenc_finalize (GObject * object)
+{
+  GstDroidSimulcastEnc *enc = GST_DROIDSIMULCASTENC (object);
+
+  GST_DEBUG_OBJECT (enc, "finalize");
+
+  g_list_free (enc->srcpads);
+  enc->srcpads = NULL;
+
+  g_mutex_clear (&enc->stream_lock);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+static GObject *
+gst_droidsimulcastenc_child_proxy_get_child_by_index (GstChildProxy * proxy,
+    guint index)
+{
+  GstDroidSimulcastEnc *enc = GST_DROIDSIMULCASTENC (proxy);
+  GObject *obj;
+
+  GST_OBJECT_LOCK (enc);
+  obj = g_list_nth_data (enc->srcpads, index);
+  if (obj) {
+    gst_object_ref (obj);
+  }
+  GST_OBJECT_UNLOCK (enc);
+
+  return obj;
+}
+
+static guint
+gst_droidsimulcastenc_child_proxy_get_children_count (GstChildProxy * proxy)
+{
+  GstDroidSimulcastEnc *enc = GST_DROIDSIMULCASTENC (proxy);
+  guint count;
+
+  GST_OBJECT_LOCK (enc);
+  count = g_list_length (enc->srcpads);
+  GST_OBJECT_UNLOCK (enc);
+
+  return count;
+}
+
+static void
+gst_droidsimulcastenc_child_proxy_init (gpointer g_iface, gpointer iface_data)
+{
+  GstChildProxyInterface *iface = g_iface;
+
+  iface->get_child_by_index =
+      gst_droidsimulcastenc_child_proxy_get_child_by_index;
+  iface->get_children_count =
+      gst_droidsimulcastenc_child_proxy_get_children_count;
+}
+
+static void
+gst_droidsimulcastenc_init (GstDroidSimulcastEnc * enc)
+{
+  enc->sinkpad =
+      gst_pad_new_from_static_template
+      (&gst_droidsimulcastenc_sink_template_factory, "sink");
+  gst_pad_set_chain_function (enc->sinkpad,
+      GST_DEBUG_FUNCPTR (gst_droidsimulcastenc_chain));
+  gst_pad_set_event_function (enc->sinkpad,
+      GST_DEBUG_FUNCPTR (gst_droidsimulcastenc_sink_event));
+  gst_element_add_pad (GST_ELEMENT (enc), enc->sinkpad);
+
+  enc->srcpads = NULL;
+  enc->next_pad_id = 0;
+  enc->bitrate = GST_DROID_SIMULCAST_ENC_BITRATE_DEFAULT;
+  enc->keyframe_interval = GST_DROID_SIMULCAST_ENC_KEYFRAME_INTERVAL_DEFAULT;
+  enc->force_keyframe = FALSE;
+  enc->have_info = FALSE;
+  enc->dirty = TRUE;
+  enc->frames_since_keyframe = 0;
+  gst_video_info_init (&enc->info);
+  g_mutex_init (&enc->stream_lock);
+}
+
+static void
+gst_droidsimulcastenc_class_init (GstDroidSimulcastEncClass * klass)
+{
+  GObjectClass *gobject_class;
+  GstElementClass *gstelement_class;
+  GstCaps *caps;
+  GstPadTemplate *tpl;
+
+  gobject_class = (GObjectClass *) klass;
+  gstelement_class = (GstElementClass *) klass;
+
+  gst_element_class_set_static_metadata (gstelement_class,
+      "Simulcast video encoder", "Encoder/Video/Device",
+      "Android HAL encoder producing several renditions of one input",
+      "Mohammed Sameer <msameer@foolab.org>");
+
+  caps = gst_droid_codec_get_all_caps (GST_DROID_CODEC_ENCODER_VIDEO);
+
+  tpl = gst_pad_template_new ("src_%u", GST_PAD_SRC, GST_PAD_REQUEST, caps);
+  gst_element_class_add_pad_template (gstelement_class, tpl);
+
+  gst_element_class_add_pad_template (gstelement_class,
+      gst_static_pad_template_get
+      (&gst_droidsimulcastenc_sink_template_factory));
+
+  gobject_class->finalize = gst_droidsimulcastenc_finalize;
+  gobject_class->set_property = gst_droidsimulcastenc_set_property;
+  gobject_class->get_property = gst_droidsimulcastenc_get_property;
+
+  gstelement_class->change_state =
+      GST_DEBUG_FUNCPTR (gst_droidsimulcastenc_change_state);
+  gstelement_class->request_new_pad =
+      GST_DEBUG_FUNCPTR (gst_droidsimulcastenc_request_new_pad);
+  gstelement_class->release_pad =
+      GST_DEBUG_FUNCPTR (gst_droidsimulcastenc_release_pad);
+
+  g_object_class_install_property (gobject_class, PROP_BITRATE,
+      g_param_spec_int ("bitrate", "Bitrate",
+          "Bitrate for a rendition of the input size. Renditions without "
+          "their own bitrate get this scaled by picture size", 0, G_MAXINT,
+          GST_DROID_SIMULCAST_ENC_BITRATE_DEFAULT,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, PROP_KEYFRAME_INTERVAL,
+      g_param_spec_uint ("keyframe-interval", "Keyframe interval",
+          "Frames between keyframes, aligned across renditions "
+          "(0 = only on request)", 0, G_MAXUINT,
+          GST_DROID_SIMULCAST_ENC_KEYFRAME_INTERVAL_DEFAULT,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+}
@@ -0,0 +1,130 @@
+/*
+ * gst-droid
+ *
+ * Copyright (C) 2015 Jolla LTD.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __GST_DROID_SIMULCAST_ENC_H__
+#define __GST_DROID_SIMULCAST_ENC_H__
+
+#include <gst/gst.h>
+#include <gst/video/video.h>
+#include "gst/droid/gstdroidcodec.h"
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_DROIDSIMULCASTENC \
+  (gst_droidsimulcastenc_get_type())
+#define GST_DROIDSIMULCASTENC(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj), GST_TYPE_DROIDSIMULCASTENC, GstDroidSimulcastEnc))
+#define GST_DROIDSIMULCASTENC_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_CAST((klass), GST_TYPE_DROIDSIMULCASTENC, GstDroidSimulcastEncClass))
+#define GST_IS_DROIDSIMULCASTENC(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE((obj), GST_TYPE_DROIDSIMULCASTENC))
+#define GST_IS_DROIDSIMULCASTENC_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_TYPE((klass), GST_TYPE_DROIDSIMULCASTENC))
+
+#define GST_TYPE_DROIDSIMULCASTENC_PAD \
+  (gst_droidsimulcastenc_pad_get_type())
+#define GST_DROIDSIMULCASTENC_PAD(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj), GST_TYPE_DROIDSIMULCASTENC_PAD, GstDroidSimulcastEncPad))
+#define GST_IS_DROIDSIMULCASTENC_PAD(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE((obj), GST_TYPE_DROIDSIMULCASTENC_PAD))
+
+typedef struct _GstDroidSimulcastEnc GstDroidSimulcastEnc;
+typedef struct _GstDroidSimulcastEncClass GstDroidSimulcastEncClass;
+typedef struct _GstDroidSimulcastEncPad GstDroidSimulcastEncPad;
+typedef struct _GstDroidSimulcastEncPadClass GstDroidSimulcastEncPadClass;
+
+/* One rendition: a src pad and the encoder session feeding it */
+struct _GstDroidSimulcastEncPad
+{
+  GstPad parent;
+
+  /* protected by object lock */
+  gint32 bitrate;
+  gboolean caps_sent;
+  /* sticky events held back until our caps went out */
+  GList *pending_events;
+
+  /* answered with the next keyframe. protected by object lock */
+  gboolean key_unit_pending;
+  GstClockTime key_unit_running_time;
+  gboolean key_unit_all_headers;
+  guint key_unit_count;
+
+  /* set up in negotiation, protected by the element stream lock */
+  GstDroidCodec *codec_type;
+  GstCaps *caps;
+  gint width;
+  gint height;
+  gint32 target_bitrate;
+
+  /* encoder session. Created with the first frame */
+  DroidMediaCodec *codec;
+  GstVideoFormat upload_format;
+  gsize stride;
+  gsize slice_height;
+  GstBufferPool *upload_pool;
+  GstDroidBucketPool *pool;
+
+  /* eos handling */
+  gboolean eos;
+  GMutex eos_lock;
+  GCond eos_cond;
+
+  /* protected by object lock */
+  GstFlowReturn flow_ret;
+};
+
+struct _GstDroidSimulcastEncPadClass
+{
+  GstPadClass parent_class;
+};
+
+struct _GstDroidSimulcastEnc
+{
+  GstElement parent;
+
+  GstPad *sinkpad;
+
+  /* protected by object lock */
+  GList *srcpads;
+  guint next_pad_id;
+  gint32 bitrate;
+  guint keyframe_interval;
+  gboolean force_keyframe;
+
+  /* protected by stream lock */
+  GMutex stream_lock;
+  GstVideoInfo info;
+  gboolean have_info;
+  gboolean dirty;
+  guint64 frames_since_keyframe;
+};
+
+struct _GstDroidSimulcastEncClass
+{
+  GstElementClass parent_class;
+};
+
+GType gst_droidsimulcastenc_get_type (void);
+GType gst_droidsimulcastenc_pad_get_type (void);
+
+G_END_DECLS
+
+#endif /* __GST_DROID_SIMULCAST_ENC_H__ */
@@ -38,6 +38,7 @@
 #endif
 
 #define GST_DROID_DEC_NUM_BUFFERS         2
+#define GST_DROID_DEC_LATENCY_WINDOW      30
 
 #define gst_droidvdec_parent_class parent_class
 G_DEFINE_TYPE (GstDroidVDec, gst_droidvdec, GST_TYPE_VIDEO_DECODER);
@@ -87,6 +88,8 @@ static void gst_droidvdec_data_available (void *data,
 static gboolean gst_droidvdec_convert_buffer (GstDroidVDec * dec,
     GstBuffer * out, DroidMediaData * in, GstVideoInfo * info);
 static void gst_droidvdec_loop (GstDroidVDec * dec);
+static void gst_droidvdec_update_latency (GstDroidVDec * dec,
+    GstVideoCodecFrame * frame);
 static GstFlowReturn gst_droidvdec_finish_frame (GstVideoDecoder * decoder,
     GstVideoCodecFrame * frame);
 
@@ -1091,6 +1094,9 @@ gst_droidvdec_start (GstVideoDecoder * decoder)
   dec->format = GST_VIDEO_FORMAT_UNKNOWN;
   dec->codec_reported_height = -1;
   dec->codec_reported_width = -1;
+  dec->max_in_flight = 0;
+  dec->window_max_in_flight = 0;
+  dec->window_frames = 0;
 
   return TRUE;
 }
@@ -1230,6 +1236,59 @@ gst_droidvdec_finish (GstVideoDecoder * decoder)
   return GST_FLOW_OK;
 }
 
+static void
+gst_droidvdec_update_latency (GstDroidVDec * dec, GstVideoCodecFrame * frame)
+{
+  /* Frames the base class handed us and we did not finish yet are the ones
+   * sitting in the codec. The deepest we have seen within the last window of
+   * frames is our latency. Going deeper raises it right away while a whole
+   * window without reaching the old depth lowers it again. */
+  GList *frames = gst_video_decoder_get_frames (GST_VIDEO_DECODER (dec));
+  guint depth = g_list_length (frames);
+  GstClockTime duration;
+  GstClockTime min, max;
+
+  g_list_free_full (frames, (GDestroyNotify) gst_video_codec_frame_unref);
+
+  dec->window_max_in_flight = MAX (dec->window_max_in_flight, depth);
+
+  if (++dec->window_frames >= GST_DROID_DEC_LATENCY_WINDOW) {
+    depth = dec->window_max_in_flight;
+    dec->window_max_in_flight = 0;
+    dec->window_frames = 0;
+  } else if (depth <= dec->max_in_flight) {
+    return;
+  }
+
+  if (depth == dec->max_in_flight) {
+    return;
+  }
+
+  if (dec->in_state->info.fps_n > 0) {
+    duration = gst_util_uint64_scale_int (GST_SECOND,
+        dec->in_state->info.fps_d, dec->in_state->info.fps_n);
+  } else {
+    duration = frame->duration;
+  }
+
+  if (!GST_CLOCK_TIME_IS_VALID (duration)) {
+    GST_LOG_OBJECT (dec, "unknown frame duration, cannot report latency");
+    return;
+  }
+
+  dec->max_in_flight = depth;
+
+  min = depth > 0 ? (depth - 1) * duration : 0;
+  max = depth * duration;
+
+  GST_INFO_OBJECT (dec, "%u frames in flight, latency min %" GST_TIME_FORMAT
+      " max %" GST_TIME_FORMAT, depth, GST_TIME_ARGS (min),
+      GST_TIME_ARGS (max));
+
+  /* this also posts a latency message */
+  gst_video_decoder_set_latency (GST_VIDEO_DECODER (dec), min, max);
+}
+
 static GstFlowReturn
 gst_droidvdec_handle_frame (GstVideoDecoder * decoder,
     GstVideoCodecFrame * frame)
@@ -1324,6 +1383,8 @@ gst_droidvdec_handle_frame (GstVideoDecoder * decoder,
    * to call get_oldest_frame() which acquires the stream lock the base class
    * is holding before calling us
    */
+  gst_droidvdec_update_latency (dec, frame);
+
   GST_LOG_OBJECT (dec, "releasing stream lock");
   GST_VIDEO_DECODER_STREAM_UNLOCK (decoder);
   droid_media_codec_queue (dec->codec, &data, &cb);
@@ -1447,6 +1508,9 @@ gst_droidvdec_init (GstDroidVDec * dec)
   dec->codec_data = NULL;
   dec->codec_reported_height = -1;
   dec->codec_reported_width = -1;
+  dec->max_in_flight = 0;
+  dec->window_max_in_flight = 0;
+  dec->window_frames = 0;
 
   g_mutex_init (&dec->state_lock);
   g_cond_init (&dec->state_cond);
@@ -74,6 +74,9 @@ struct _GstDroidVDec
   gboolean dirty;
   DroidMediaRect crop_rect;
   gboolean running;
+  guint max_in_flight;
+  guint window_max_in_flight;
+  guint window_frames;
   gboolean use_hardware_buffers;
   GstVideoFormat format;
 
@@ -25,8 +25,12 @@
 
 #include "gstdroidvenc.h"
 #include "gst/droid/gstwrappedmemory.h"
+#include "gst/droid/gstdroidmediabuffer.h"
+#include "gst/droid/gstdroidtemporallayermeta.h"
 #include "gst/droid/gstdroidquery.h"
+#include "gst/droid/gstdroidvideoupload.h"
 #include "plugin.h"
+#include "droidmediaconstants.h"
 #include <string.h>
 
 #define gst_droidvenc_parent_class parent_class
@@ -37,24 +41,64 @@ GST_DEBUG_CATEGORY_EXTERN (gst_droid_venc_debug);
 
 #define GST_DROIDVENC_EOS_TIMEOUT_SEC          2
 
+/* OMX_COLOR_FormatAndroidOpaque: the encoder reads gralloc buffers directly */
+#define GST_DROIDVENC_COLOR_FORMAT_ANDROID_OPAQUE 0x7F000789
+
+#if HAVE_DECL_DROID_MEDIA_CODEC_QUEUE_BUFFER
+#define GST_DROIDVENC_HARDWARE_BUFFER_CAPS ";" \
+    GST_VIDEO_CAPS_MAKE_WITH_FEATURES \
+    (GST_CAPS_FEATURE_MEMORY_DROID_MEDIA_QUEUE_BUFFER, \
+        GST_DROID_MEDIA_BUFFER_MEMORY_VIDEO_FORMATS) ";" \
+    GST_VIDEO_CAPS_MAKE_WITH_FEATURES \
+    (GST_CAPS_FEATURE_MEMORY_DROID_MEDIA_BUFFER, \
+        GST_DROID_MEDIA_BUFFER_MEMORY_VIDEO_FORMATS)
+#else
+#define GST_DROIDVENC_HARDWARE_BUFFER_CAPS ""
+#endif
+
 static GstStaticPadTemplate gst_droidvenc_sink_template_factory =
 GST_STATIC_PAD_TEMPLATE (GST_VIDEO_ENCODER_SINK_NAME,
     GST_PAD_SINK,
     GST_PAD_ALWAYS,
     GST_STATIC_CAPS (GST_VIDEO_CAPS_MAKE_WITH_FEATURES
-        (GST_CAPS_FEATURE_MEMORY_DROID_VIDEO_META_DATA, "{YV12}")));
+        (GST_CAPS_FEATURE_MEMORY_DROID_VIDEO_META_DATA, "{YV12}")
+        GST_DROIDVENC_HARDWARE_BUFFER_CAPS ";"
+        GST_VIDEO_CAPS_MAKE ("{I420, NV12}")));
 
 enum
 {
   PROP_0,
   PROP_TARGET_BITRATE,
+  PROP_RATE_CONTROL,
+  PROP_I_FRAME_INTERVAL,
+  PROP_B_FRAMES,
+  PROP_MIN_QP,
+  PROP_MAX_QP,
+  PROP_SLICES_PER_FRAME,
+  PROP_TEMPORAL_LAYERS,
+  PROP_LTR_COUNT,
+  PROP_MARK_LTR,
+  PROP_USE_LTR,
+  PROP_ROI_QP_DELTA,
 };
 
 #define GST_DROID_ENC_TARGET_BITRATE_DEFAULT 192000
+#define GST_DROID_ENC_RATE_CONTROL_DEFAULT GST_DROIDVENC_RATE_CONTROL_DEFAULT
+#define GST_DROID_ENC_I_FRAME_INTERVAL_DEFAULT 1
+#define GST_DROID_ENC_B_FRAMES_DEFAULT 0
+#define GST_DROID_ENC_QP_DEFAULT -1
+#define GST_DROID_ENC_SLICES_PER_FRAME_DEFAULT 0
+#define GST_DROID_ENC_TEMPORAL_LAYERS_DEFAULT 1
+#define GST_DROID_ENC_LTR_COUNT_DEFAULT 0
+#define GST_DROID_ENC_MAX_LTR_COUNT 8
+#define GST_DROID_ENC_ROI_QP_DELTA_DEFAULT -6
+#define GST_DROID_ENC_MAX_ROI 8
+#define GST_DROID_ENC_LATENCY_WINDOW 30
 
 typedef struct
 {
   GstMapInfo info;
+  GstBuffer *mapped;
   GstVideoCodecFrame *frame;
 } GstDroidVEncFrameReleaseData;
 
@@ -65,6 +109,38 @@ static void gst_droidvenc_error (void *data, int err);
 static void
 gst_droidvenc_data_available (void *data, DroidMediaCodecData * encoded);
 static void gst_droidvenc_release_input_frame (void *data);
+static void gst_droidvenc_update_latency (GstDroidVEnc * enc,
+    GstVideoCodecFrame * frame);
+static void gst_droidvenc_update_roi (GstDroidVEnc * enc,
+    GstVideoCodecFrame * frame);
+static void gst_droidvenc_update_codec (GstDroidVEnc * enc,
+    GstVideoCodecFrame * frame);
+static void gst_droidvenc_fill_encoder_settings (GstDroidVEnc * enc,
+    DroidMediaCodecEncoderMetaData * md);
+static GstFlowReturn gst_droidvenc_push_nals (GstDroidVEnc * enc,
+    DroidMediaCodecData * encoded, gboolean end_of_frame);
+static gboolean gst_droidvenc_create_upload_pool (GstDroidVEnc * enc,
+    DroidMediaCodecEncoderMetaData * md);
+
+GType
+gst_droidvenc_rate_control_get_type (void)
+{
+  static GType gst_droidvenc_rate_control_type = 0;
+  static GEnumValue gst_droidvenc_rate_controls[] = {
+    {GST_DROIDVENC_RATE_CONTROL_DEFAULT, "Codec default", "default"},
+    {GST_DROIDVENC_RATE_CONTROL_CQ, "Constant quality", "cq"},
+    {GST_DROIDVENC_RATE_CONTROL_VBR, "Variable bitrate", "vbr"},
+    {GST_DROIDVENC_RATE_CONTROL_CBR, "Constant bitrate", "cbr"},
+    {0, NULL, NULL},
+  };
+
+  if (G_UNLIKELY (!gst_droidvenc_rate_control_type)) {
+    gst_droidvenc_rate_control_type =
+        g_enum_register_static ("GstDroidVEncRateControl",
+        gst_droidvenc_rate_controls);
+  }
+  return gst_droidvenc_rate_control_type;
+}
 
 static void
 gst_droidvenc_release_input_frame (void *data)
@@ -72,11 +148,20 @@ gst_droidvenc_release_input_frame (void *data)
   GstDroidVEncFrameReleaseData *release_data =
       (GstDroidVEncFrameReleaseData *) data;
 
-  gst_buffer_unmap (release_data->frame->input_buffer, &release_data->info);
+  if (release_data->mapped) {
+    gst_buffer_unmap (release_data->mapped, &release_data->info);
+
+    if (release_data->mapped != release_data->frame->input_buffer) {
+      /* upload buffer */
+      gst_buffer_unref (release_data->mapped);
+    }
+  }
 
   /* We need to release the input buffer */
-  gst_buffer_unref (release_data->frame->input_buffer);
-  release_data->frame->input_buffer = NULL;
+  if (release_data->frame->input_buffer) {
+    gst_buffer_unref (release_data->frame->input_buffer);
+    release_data->frame->input_buffer = NULL;
+  }
 
   gst_video_codec_frame_unref (release_data->frame);
 
@@ -87,16 +172,29 @@ static gboolean
 gst_droidvenc_negotiate_src_caps (GstDroidVEnc * enc)
 {
   GstCaps *caps;
+  GstCaps *tpl;
 
   GST_DEBUG_OBJECT (enc, "negotiate src caps");
 
+  tpl =
+      gst_pad_get_pad_template_caps (GST_VIDEO_ENCODER_SRC_PAD
+      (GST_VIDEO_ENCODER (enc)));
   caps =
       gst_pad_peer_query_caps (GST_VIDEO_ENCODER_SRC_PAD (GST_VIDEO_ENCODER
-          (enc)), NULL);
+          (enc)), tpl);
+  gst_caps_unref (tpl);
 
   GST_LOG_OBJECT (enc, "peer caps %" GST_PTR_FORMAT, caps);
 
-  caps = gst_caps_truncate (caps);
+  if (gst_caps_is_empty (caps)) {
+    GST_ELEMENT_ERROR (enc, STREAM, FORMAT, (NULL),
+        ("downstream does not accept any of our formats"));
+    gst_caps_unref (caps);
+    goto error;
+  }
+
+  /* fixate now so we can pick profile and level requested by downstream */
+  caps = gst_caps_fixate (caps);
 
   enc->codec_type =
       gst_droid_codec_new_from_caps (caps, GST_DROID_CODEC_ENCODER_VIDEO);
@@ -111,6 +209,13 @@ gst_droidvenc_negotiate_src_caps (GstDroidVEnc * enc)
   /* ownership of caps is transferred */
   enc->out_state = gst_droidvenc_configure_state (enc, caps);
 
+  enc->nal_aligned =
+      !g_strcmp0 (gst_structure_get_string (gst_caps_get_structure
+          (enc->out_state->caps, 0), "alignment"), "nal");
+  enc->in_frame = FALSE;
+
+  GST_INFO_OBJECT (enc, "nal aligned output: %d", enc->nal_aligned);
+
   return TRUE;
 
 error:
@@ -125,25 +230,43 @@ gst_droidvenc_create_codec (GstDroidVEnc * enc)
 
   const gchar *droid = gst_droid_codec_get_droid_type (enc->codec_type);
 
+  memset (&md, 0x0, sizeof (md));
+
+  GST_OBJECT_LOCK (enc);
+  md.bitrate = enc->target_bitrate;
+  enc->target_bitrate_changed = FALSE;
+  GST_OBJECT_UNLOCK (enc);
+
   GST_INFO_OBJECT (enc,
       "create codec of type: %s resolution: %dx%d bitrate: %d", droid,
-      enc->in_state->info.width, enc->in_state->info.height,
-      enc->target_bitrate);
-
-  memset (&md, 0x0, sizeof (md));
+      enc->in_state->info.width, enc->in_state->info.height, md.bitrate);
 
   md.parent.type = droid;
   md.parent.width = enc->in_state->info.width;
   md.parent.height = enc->in_state->info.height;
   md.parent.fps = enc->in_state->info.fps_n / enc->in_state->info.fps_d;        // TODO: bad
   md.parent.flags = DROID_MEDIA_CODEC_HW_ONLY;
-  md.bitrate = enc->target_bitrate;
   md.stride = enc->in_state->info.width;
   md.slice_height = enc->in_state->info.height;
 
-  /* TODO: get this from caps */
+  gst_droidvenc_fill_encoder_settings (enc, &md);
+
   md.meta_data = true;
 
+  if (enc->use_system_memory) {
+    if (!gst_droidvenc_create_upload_pool (enc, &md)) {
+      return FALSE;
+    }
+
+    goto create;
+  }
+
+  if (enc->use_hardware_buffers) {
+    /* No need to ask upstream. We hand the encoder gralloc buffers. */
+    md.color_format = GST_DROIDVENC_COLOR_FORMAT_ANDROID_OPAQUE;
+    goto create;
+  }
+
   query = gst_droid_query_new_video_color_format ();
   if (!gst_pad_peer_query (GST_VIDEO_ENCODER_SINK_PAD (GST_VIDEO_ENCODER (enc)),
           query)) {
@@ -162,6 +285,10 @@ gst_droidvenc_create_codec (GstDroidVEnc * enc)
 
   gst_query_unref (query);
 
+create:
+  /* a new codec knows nothing about our regions */
+  g_array_set_size (enc->roi, 0);
+
   enc->codec = droid_media_codec_create_encoder (&md);
 
   if (!enc->codec) {
@@ -195,6 +322,226 @@ gst_droidvenc_create_codec (GstDroidVEnc * enc)
   return TRUE;
 }
 
+static void
+gst_droidvenc_destroy_upload_pool (GstDroidVEnc * enc)
+{
+  if (enc->upload_pool) {
+    gst_buffer_pool_set_active (enc->upload_pool, FALSE);
+    gst_object_unref (enc->upload_pool);
+    enc->upload_pool = NULL;
+  }
+}
+
+static gboolean
+gst_droidvenc_create_upload_pool (GstDroidVEnc * enc,
+    DroidMediaCodecEncoderMetaData * md)
+{
+  /*
+   * Nobody upstream can tell us the color format so we pick one the encoder
+   * takes and copy the frames into it ourselves. Most encoders want
+   * semi planar input with stride and slice height aligned to 16.
+   */
+  DroidMediaColourFormatConstants constants;
+  GstStructure *config;
+
+  droid_media_colour_format_constants_init (&constants);
+
+  if (enc->codec_type->quirks & USE_PLANAR_INPUT_VALUE) {
+    enc->upload_format = GST_VIDEO_FORMAT_I420;
+    md->color_format = constants.OMX_COLOR_FormatYUV420Planar;
+  } else {
+    enc->upload_format = GST_VIDEO_FORMAT_NV12;
+    md->color_format = constants.OMX_COLOR_FormatYUV420SemiPlanar;
+  }
+
+  enc->upload_stride = GST_ROUND_UP_16 (enc->in_state->info.width);
+  enc->upload_slice_height = GST_ROUND_UP_16 (enc->in_state->info.height);
+
+  md->meta_data = false;
+  md->stride = enc->upload_stride;
+  md->slice_height = enc->upload_slice_height;
+
+  GST_INFO_OBJECT (enc, "uploading %s input as %s %" G_GSIZE_FORMAT "x%"
+      G_GSIZE_FORMAT, gst_video_format_to_string (GST_VIDEO_INFO_FORMAT
+          (&enc->in_state->info)),
+      gst_video_format_to_string (enc->upload_format), enc->upload_stride,
+      enc->upload_slice_height);
+
+  gst_droidvenc_destroy_upload_pool (enc);
+
+  enc->upload_pool = gst_buffer_pool_new ();
+  config = gst_buffer_pool_get_config (enc->upload_pool);
+  gst_buffer_pool_config_set_params (config, NULL,
+      gst_droid_video_upload_get_size (enc->upload_format, enc->upload_stride,
+          enc->upload_slice_height), 0, 0);
+
+  if (!gst_buffer_pool_set_config (enc->upload_pool, config)
+      || !gst_buffer_pool_set_active (enc->upload_pool, TRUE)) {
+    gst_object_unref (enc->upload_pool);
+    enc->upload_pool = NULL;
+    GST_ELEMENT_ERROR (enc, RESOURCE, NO_SPACE_LEFT, (NULL),
+        ("Failed to create upload buffer pool"));
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+static GQuark
+gst_droidvenc_upload_zeroed_quark (void)
+{
+  static GQuark quark = 0;
+
+  if (!quark) {
+    quark = g_quark_from_static_string ("GstDroidVEncUploadZeroed");
+  }
+
+  return quark;
+}
+
+static GstBuffer *
+gst_droidvenc_upload_frame (GstDroidVEnc * enc, GstVideoCodecFrame * frame,
+    GstMapInfo * info)
+{
+  GstVideoFrame vframe;
+  GstBuffer *buffer = NULL;
+  gboolean ret;
+
+  if (gst_buffer_pool_acquire_buffer (enc->upload_pool, &buffer,
+          NULL) != GST_FLOW_OK) {
+    GST_ERROR_OBJECT (enc, "failed to acquire upload buffer");
+    return NULL;
+  }
+
+  if (!gst_video_frame_map (&vframe, &enc->in_state->info, frame->input_buffer,
+          GST_MAP_READ)) {
+    GST_ERROR_OBJECT (enc, "failed to map input frame");
+    gst_buffer_unref (buffer);
+    return NULL;
+  }
+
+  if (!gst_buffer_map (buffer, info, GST_MAP_READWRITE)) {
+    GST_ERROR_OBJECT (enc, "failed to map upload buffer");
+    gst_video_frame_unmap (&vframe);
+    gst_buffer_unref (buffer);
+    return NULL;
+  }
+
+  /* The upload only writes the visible area. Clear the stride and slice
+   * height padding once per pool buffer so the encoder never reads garbage */
+  if (!gst_mini_object_get_qdata (GST_MINI_OBJECT (buffer),
+          gst_droidvenc_upload_zeroed_quark ())) {
+    memset (info->data, 0, info->size);
+    gst_mini_object_set_qdata (GST_MINI_OBJECT (buffer),
+        gst_droidvenc_upload_zeroed_quark (), GINT_TO_POINTER (TRUE), NULL);
+  }
+
+  ret = gst_droid_video_upload (&vframe, info->data, enc->upload_format,
+      enc->upload_stride, enc->upload_slice_height);
+
+  gst_video_frame_unmap (&vframe);
+
+  if (!ret) {
+    gst_buffer_unmap (buffer, info);
+    gst_buffer_unref (buffer);
+    return NULL;
+  }
+
+  /* We don't need the input anymore. Let upstream reuse it. */
+  gst_buffer_unref (frame->input_buffer);
+  frame->input_buffer = NULL;
+
+  return buffer;
+}
+
+static void
+gst_droidvenc_fill_encoder_settings (GstDroidVEnc * enc,
+    DroidMediaCodecEncoderMetaData * md)
+{
+  gint profile, level;
+
+  gst_droid_codec_get_profile_level (enc->codec_type, &profile, &level);
+
+  GST_INFO_OBJECT (enc,
+      "rate control: %d, i-frame interval: %d, b-frames: %u, "
+      "profile: 0x%x, level: 0x%x, qp: [%d, %d], slices: %u, "
+      "temporal layers: %u, ltr frames: %u", enc->rate_control,
+      enc->i_frame_interval, enc->b_frames, profile, level, enc->min_qp,
+      enc->max_qp, enc->slices, enc->temporal_layers, enc->ltr_count);
+
+#ifdef HAVE_DROIDMEDIACODECENCODERMETADATA_BITRATE_MODE
+  md->bitrate_mode = enc->rate_control;
+#else
+  if (enc->rate_control != GST_DROIDVENC_RATE_CONTROL_DEFAULT) {
+    GST_WARNING_OBJECT (enc, "rate control mode is not supported");
+  }
+#endif
+
+#ifdef HAVE_DROIDMEDIACODECENCODERMETADATA_I_FRAME_INTERVAL
+  md->i_frame_interval = enc->i_frame_interval;
+#else
+  if (enc->i_frame_interval != GST_DROID_ENC_I_FRAME_INTERVAL_DEFAULT) {
+    GST_WARNING_OBJECT (enc, "setting i-frame interval is not supported");
+  }
+#endif
+
+#ifdef HAVE_DROIDMEDIACODECENCODERMETADATA_B_FRAMES
+  md->b_frames = enc->b_frames;
+#else
+  if (enc->b_frames != GST_DROID_ENC_B_FRAMES_DEFAULT) {
+    GST_WARNING_OBJECT (enc, "setting b-frames is not supported");
+  }
+#endif
+
+#if defined (HAVE_DROIDMEDIACODECENCODERMETADATA_PROFILE) && defined (HAVE_DROIDMEDIACODECENCODERMETADATA_LEVEL)
+  md->profile = profile;
+  md->level = level;
+#else
+  if (profile || level) {
+    GST_WARNING_OBJECT (enc, "setting profile and level is not supported");
+  }
+#endif
+
+#if defined (HAVE_DROIDMEDIACODECENCODERMETADATA_MIN_QP) && defined (HAVE_DROIDMEDIACODECENCODERMETADATA_MAX_QP)
+  md->min_qp = enc->min_qp;
+  md->max_qp = enc->max_qp;
+#else
+  if (enc->min_qp != GST_DROID_ENC_QP_DEFAULT
+      || enc->max_qp != GST_DROID_ENC_QP_DEFAULT) {
+    GST_WARNING_OBJECT (enc, "setting qp bounds is not supported");
+  }
+#endif
+
+#ifdef HAVE_DROIDMEDIACODECENCODERMETADATA_SLICES
+  md->slices = enc->slices;
+#else
+  if (enc->slices != GST_DROID_ENC_SLICES_PER_FRAME_DEFAULT) {
+    GST_WARNING_OBJECT (enc, "setting slices per frame is not supported");
+  }
+#endif
+
+  enc->codec_temporal_layers = GST_DROID_ENC_TEMPORAL_LAYERS_DEFAULT;
+  enc->codec_ltr_count = GST_DROID_ENC_LTR_COUNT_DEFAULT;
+
+#ifdef HAVE_DROIDMEDIACODECENCODERMETADATA_TEMPORAL_LAYERS
+  md->temporal_layers = enc->temporal_layers;
+  enc->codec_temporal_layers = enc->temporal_layers;
+#else
+  if (enc->temporal_layers != GST_DROID_ENC_TEMPORAL_LAYERS_DEFAULT) {
+    GST_WARNING_OBJECT (enc, "temporal layers are not supported");
+  }
+#endif
+
+#ifdef HAVE_DROIDMEDIACODECENCODERMETADATA_LTR_COUNT
+  md->ltr_count = enc->ltr_count;
+  enc->codec_ltr_count = enc->ltr_count;
+#else
+  if (enc->ltr_count != GST_DROID_ENC_LTR_COUNT_DEFAULT) {
+    GST_WARNING_OBJECT (enc, "long term reference frames are not supported");
+  }
+#endif
+}
+
 static void
 gst_droidvenc_signal_eos (void *data)
 {
@@ -238,6 +585,149 @@ out:
   g_mutex_unlock (&enc->eos_lock);
 }
 
+static guint
+gst_droidvenc_get_temporal_layer_id (GstDroidVEnc * enc,
+    DroidMediaCodecData * encoded)
+{
+  guint pos;
+
+  if (encoded->sync) {
+    enc->frames_since_sync = 0;
+  }
+
+  pos = enc->frames_since_sync++;
+
+#ifdef HAVE_DROIDMEDIACODECDATA_TEMPORAL_LAYER_ID
+  return encoded->temporal_layer_id;
+#else
+  /*
+   * The codec does not tell us so we follow the usual dyadic pattern
+   * starting at each sync frame, e.g. 0, 2, 1, 2 for 3 layers.
+   */
+  if (enc->codec_temporal_layers <= 1) {
+    return 0;
+  }
+
+  pos %= 1 << (enc->codec_temporal_layers - 1);
+  if (pos == 0) {
+    return 0;
+  }
+
+  return enc->codec_temporal_layers - 1 - g_bit_nth_lsf (pos, -1);
+#endif
+}
+
+static void
+gst_droidvenc_add_temporal_layer_meta (GstDroidVEnc * enc, GstBuffer * buffer,
+    guint layer_id, gboolean ltr)
+{
+  /* Only if the codec really produces layers or long term references */
+  if (enc->codec_temporal_layers > 1 || enc->codec_ltr_count > 0) {
+    gst_buffer_add_droid_temporal_layer_meta (buffer, layer_id,
+        enc->codec_temporal_layers, ltr);
+  }
+}
+
+static GstFlowReturn
+gst_droidvenc_push_nals (GstDroidVEnc * enc, DroidMediaCodecData * encoded,
+    gboolean end_of_frame)
+{
+  /*
+   * Each NAL goes downstream in its own buffer. The first one finishes the
+   * frame so the base class can push pending events and handle force key unit
+   * requests. The rest are pushed directly with the same timestamps.
+   * If droidmedia gives us partial frames then the following calls push the
+   * remaining NALs of the frame. Must be called with the stream lock held.
+   */
+  GstVideoEncoder *encoder = GST_VIDEO_ENCODER (enc);
+  GstFlowReturn flow_ret = GST_FLOW_OK;
+  GstBuffer *buffer;
+  GstMapInfo info;
+  gsize offset = 0;
+  gsize size;
+
+  buffer =
+      gst_droid_codec_prepare_encoded_data (enc->codec_type, &encoded->data,
+      enc->pool);
+  if (!buffer) {
+    GST_ERROR_OBJECT (enc, "failed to process encoded data");
+    return GST_FLOW_ERROR;
+  }
+
+  gst_buffer_map (buffer, &info, GST_MAP_READ);
+  size = info.size;
+
+  while (flow_ret == GST_FLOW_OK && offset + 4 <= size) {
+    gsize nal_size = GST_READ_UINT32_BE (info.data + offset);
+    GstBuffer *nal;
+    gboolean last;
+
+    if (offset + 4 + nal_size > size) {
+      GST_WARNING_OBJECT (enc, "truncated NAL");
+      break;
+    }
+
+    last = end_of_frame && offset + 4 + nal_size == size;
+
+    /* This shares the memory with the encoded buffer */
+    nal =
+        gst_buffer_copy_region (buffer, GST_BUFFER_COPY_MEMORY, offset,
+        4 + nal_size);
+    offset += 4 + nal_size;
+
+    if (last) {
+      GST_BUFFER_FLAG_SET (nal, GST_BUFFER_FLAG_MARKER);
+    }
+
+    if (!enc->in_frame) {
+      GstVideoCodecFrame *frame = gst_video_encoder_get_oldest_frame (encoder);
+      if (G_UNLIKELY (!frame)) {
+        GST_WARNING_OBJECT (enc, "buffer without frame");
+        gst_buffer_unref (nal);
+        break;
+      }
+
+      if (encoded->sync) {
+        GST_VIDEO_CODEC_FRAME_SET_SYNC_POINT (frame);
+      }
+
+      enc->frame_pts = frame->pts;
+      enc->frame_dts = frame->dts;
+      enc->frame_sync = encoded->sync;
+      enc->frame_layer_id = gst_droidvenc_get_temporal_layer_id (enc, encoded);
+      enc->frame_ltr = gst_video_codec_frame_get_user_data (frame) != NULL;
+      enc->in_frame = TRUE;
+
+      gst_droidvenc_add_temporal_layer_meta (enc, nal, enc->frame_layer_id,
+          enc->frame_ltr);
+
+      frame->output_buffer = nal;
+      flow_ret = gst_video_encoder_finish_frame (encoder, frame);
+      gst_video_codec_frame_unref (frame);
+    } else {
+      GST_BUFFER_PTS (nal) = enc->frame_pts;
+      GST_BUFFER_DTS (nal) = enc->frame_dts;
+      if (!enc->frame_sync) {
+        GST_BUFFER_FLAG_SET (nal, GST_BUFFER_FLAG_DELTA_UNIT);
+      }
+
+      gst_droidvenc_add_temporal_layer_meta (enc, nal, enc->frame_layer_id,
+          enc->frame_ltr);
+
+      flow_ret = gst_pad_push (GST_VIDEO_ENCODER_SRC_PAD (encoder), nal);
+    }
+  }
+
+  gst_buffer_unmap (buffer, &info);
+  gst_buffer_unref (buffer);
+
+  if (end_of_frame) {
+    enc->in_frame = FALSE;
+  }
+
+  return flow_ret;
+}
+
 static void
 gst_droidvenc_data_available (void *data, DroidMediaCodecData * encoded)
 {
@@ -276,6 +766,15 @@ gst_droidvenc_data_available (void *data, DroidMediaCodecData * encoded)
     return;
   }
 
+  if (enc->nal_aligned) {
+    gboolean end_of_frame = TRUE;
+#ifdef HAVE_DROIDMEDIACODECDATA_END_OF_FRAME
+    end_of_frame = encoded->end_of_frame;
+#endif
+    flow_ret = gst_droidvenc_push_nals (enc, encoded, end_of_frame);
+    goto check;
+  }
+
   frame = gst_video_encoder_get_oldest_frame (GST_VIDEO_ENCODER (enc));
   if (G_UNLIKELY (!frame)) {
     /* TODO: what should we do here? */
@@ -286,7 +785,8 @@ gst_droidvenc_data_available (void *data, DroidMediaCodecData * encoded)
   }
 
   frame->output_buffer =
-      gst_droid_codec_prepare_encoded_data (enc->codec_type, &encoded->data);
+      gst_droid_codec_prepare_encoded_data (enc->codec_type, &encoded->data,
+      enc->pool);
   if (!frame->output_buffer) {
     GST_ELEMENT_ERROR (enc, LIBRARY, ENCODE, (NULL),
         ("failed to process encoded data"));
@@ -304,10 +804,15 @@ gst_droidvenc_data_available (void *data, DroidMediaCodecData * encoded)
     GST_VIDEO_CODEC_FRAME_SET_SYNC_POINT (frame);
   }
 
+  gst_droidvenc_add_temporal_layer_meta (enc, frame->output_buffer,
+      gst_droidvenc_get_temporal_layer_id (enc, encoded),
+      gst_video_codec_frame_get_user_data (frame) != NULL);
+
   flow_ret = gst_video_encoder_finish_frame (GST_VIDEO_ENCODER (enc), frame);
   /* release our ref */
   gst_video_codec_frame_unref (frame);
 
+check:
   if (flow_ret == GST_FLOW_OK || flow_ret == GST_FLOW_FLUSHING) {
     goto out;
   } else if (flow_ret == GST_FLOW_EOS) {
@@ -351,7 +856,57 @@ gst_droidvenc_set_property (GObject * object, guint prop_id,
 
   switch (prop_id) {
     case PROP_TARGET_BITRATE:
-      enc->target_bitrate = g_value_get_int (value);
+    {
+      gint32 bitrate = g_value_get_int (value);
+
+      GST_OBJECT_LOCK (enc);
+      if (bitrate != enc->target_bitrate) {
+        enc->target_bitrate = bitrate;
+        enc->target_bitrate_changed = TRUE;
+      }
+      GST_OBJECT_UNLOCK (enc);
+    }
+      break;
+    case PROP_RATE_CONTROL:
+      enc->rate_control = g_value_get_enum (value);
+      break;
+    case PROP_I_FRAME_INTERVAL:
+      enc->i_frame_interval = g_value_get_int (value);
+      break;
+    case PROP_B_FRAMES:
+      enc->b_frames = g_value_get_uint (value);
+      break;
+    case PROP_MIN_QP:
+      enc->min_qp = g_value_get_int (value);
+      break;
+    case PROP_MAX_QP:
+      enc->max_qp = g_value_get_int (value);
+      break;
+    case PROP_SLICES_PER_FRAME:
+      enc->slices = g_value_get_uint (value);
+      break;
+    case PROP_TEMPORAL_LAYERS:
+      enc->temporal_layers = g_value_get_uint (value);
+      break;
+    case PROP_LTR_COUNT:
+      enc->ltr_count = g_value_get_uint (value);
+      break;
+    case PROP_MARK_LTR:
+      GST_OBJECT_LOCK (enc);
+      enc->mark_ltr = g_value_get_int (value);
+      enc->mark_ltr_pending = enc->mark_ltr != -1;
+      GST_OBJECT_UNLOCK (enc);
+      break;
+    case PROP_USE_LTR:
+      GST_OBJECT_LOCK (enc);
+      enc->use_ltr = g_value_get_int (value);
+      enc->use_ltr_pending = enc->use_ltr != -1;
+      GST_OBJECT_UNLOCK (enc);
+      break;
+    case PROP_ROI_QP_DELTA:
+      GST_OBJECT_LOCK (enc);
+      enc->roi_qp_delta = g_value_get_int (value);
+      GST_OBJECT_UNLOCK (enc);
       break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
@@ -367,7 +922,48 @@ gst_droidvenc_get_property (GObject * object, guint prop_id, GValue * value,
 
   switch (prop_id) {
     case PROP_TARGET_BITRATE:
+      GST_OBJECT_LOCK (enc);
       g_value_set_int (value, enc->target_bitrate);
+      GST_OBJECT_UNLOCK (enc);
+      break;
+    case PROP_RATE_CONTROL:
+      g_value_set_enum (value, enc->rate_control);
+      break;
+    case PROP_I_FRAME_INTERVAL:
+      g_value_set_int (value, enc->i_frame_interval);
+      break;
+    case PROP_B_FRAMES:
+      g_value_set_uint (value, enc->b_frames);
+      break;
+    case PROP_MIN_QP:
+      g_value_set_int (value, enc->min_qp);
+      break;
+    case PROP_MAX_QP:
+      g_value_set_int (value, enc->max_qp);
+      break;
+    case PROP_SLICES_PER_FRAME:
+      g_value_set_uint (value, enc->slices);
+      break;
+    case PROP_TEMPORAL_LAYERS:
+      g_value_set_uint (value, enc->temporal_layers);
+      break;
+    case PROP_LTR_COUNT:
+      g_value_set_uint (value, enc->ltr_count);
+      break;
+    case PROP_MARK_LTR:
+      GST_OBJECT_LOCK (enc);
+      g_value_set_int (value, enc->mark_ltr);
+      GST_OBJECT_UNLOCK (enc);
+      break;
+    case PROP_USE_LTR:
+      GST_OBJECT_LOCK (enc);
+      g_value_set_int (value, enc->use_ltr);
+      GST_OBJECT_UNLOCK (enc);
+      break;
+    case PROP_ROI_QP_DELTA:
+      GST_OBJECT_LOCK (enc);
+      g_value_set_int (value, enc->roi_qp_delta);
+      GST_OBJECT_UNLOCK (enc);
       break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
@@ -384,6 +980,8 @@ gst_droidvenc_finalize (GObject * object)
 
   enc->codec = NULL;
 
+  g_array_free (enc->roi, TRUE);
+
   g_mutex_clear (&enc->eos_lock);
   g_cond_clear (&enc->eos_cond);
 
@@ -424,6 +1022,16 @@ gst_droidvenc_start (GstVideoEncoder * encoder)
   enc->eos = FALSE;
   enc->downstream_flow_ret = GST_FLOW_OK;
   enc->dirty = TRUE;
+  enc->pool = gst_droid_bucket_pool_new ();
+  enc->in_frame = FALSE;
+  enc->frames_since_sync = 0;
+  enc->codec_temporal_layers = GST_DROID_ENC_TEMPORAL_LAYERS_DEFAULT;
+  enc->codec_ltr_count = GST_DROID_ENC_LTR_COUNT_DEFAULT;
+  g_array_set_size (enc->roi, 0);
+  enc->roi_warned = FALSE;
+  enc->max_in_flight = 0;
+  enc->window_max_in_flight = 0;
+  enc->window_frames = 0;
 
   return TRUE;
 }
@@ -457,6 +1065,13 @@ gst_droidvenc_stop (GstVideoEncoder * encoder)
     enc->codec_type = NULL;
   }
 
+  if (enc->pool) {
+    gst_droid_bucket_pool_free (enc->pool);
+    enc->pool = NULL;
+  }
+
+  gst_droidvenc_destroy_upload_pool (enc);
+
   return TRUE;
 }
 
@@ -465,6 +1080,7 @@ gst_droidvenc_set_format (GstVideoEncoder * encoder, GstVideoCodecState * state)
 {
   GstDroidVEnc *enc = GST_DROIDVENC (encoder);
   gboolean ret = FALSE;
+  GstCapsFeatures *features;
 
   GST_DEBUG_OBJECT (enc, "set format %" GST_PTR_FORMAT, state->caps);
 
@@ -476,6 +1092,20 @@ gst_droidvenc_set_format (GstVideoEncoder * encoder, GstVideoCodecState * state)
 
   enc->first_frame_sent = FALSE;
 
+  features = gst_caps_get_features (state->caps, 0);
+  enc->use_hardware_buffers =
+      gst_caps_features_contains (features,
+      GST_CAPS_FEATURE_MEMORY_DROID_MEDIA_QUEUE_BUFFER)
+      || gst_caps_features_contains (features,
+      GST_CAPS_FEATURE_MEMORY_DROID_MEDIA_BUFFER);
+
+  enc->use_system_memory =
+      gst_caps_features_contains (features,
+      GST_CAPS_FEATURE_MEMORY_SYSTEM_MEMORY);
+
+  GST_INFO_OBJECT (enc, "using hardware buffers: %d, system memory: %d",
+      enc->use_hardware_buffers, enc->use_system_memory);
+
   enc->in_state = gst_video_codec_state_ref (state);
 
   if (!gst_droidvenc_negotiate_src_caps (enc)) {
@@ -556,6 +1186,7 @@ gst_droidvenc_handle_frame (GstVideoEncoder * encoder,
   GstMapInfo info;
   DroidMediaBufferCallbacks cb;
   GstDroidVEncFrameReleaseData *release_data;
+  DroidMediaBuffer *buffer = NULL;
 
   GST_DEBUG_OBJECT (enc, "handle frame");
 
@@ -586,14 +1217,47 @@ gst_droidvenc_handle_frame (GstVideoEncoder * encoder,
     enc->dirty = FALSE;
   }
 
-  gst_buffer_map (frame->input_buffer, &info, GST_MAP_READ);
-  data.data.size = info.size;
-  data.data.data = info.data;
+  gst_droidvenc_update_codec (enc, frame);
+
   data.sync = false;
   data.ts = GST_TIME_AS_USECONDS (frame->pts);
 
   release_data = g_slice_new (GstDroidVEncFrameReleaseData);
-  release_data->info = info;
+  release_data->mapped = NULL;
+
+  if (enc->use_hardware_buffers) {
+    buffer =
+        gst_droid_media_buffer_memory_get_buffer_from_gst_buffer
+        (frame->input_buffer);
+    if (!buffer) {
+      g_slice_free (GstDroidVEncFrameReleaseData, release_data);
+      GST_ELEMENT_ERROR (enc, STREAM, FORMAT, (NULL),
+          ("input buffer is not backed by a droid media buffer"));
+      goto error;
+    }
+
+    data.data.size = 0;
+    data.data.data = NULL;
+  } else if (enc->use_system_memory) {
+    release_data->mapped = gst_droidvenc_upload_frame (enc, frame, &info);
+    if (!release_data->mapped) {
+      g_slice_free (GstDroidVEncFrameReleaseData, release_data);
+      GST_ELEMENT_ERROR (enc, STREAM, FORMAT, (NULL),
+          ("Failed to upload input frame"));
+      goto error;
+    }
+
+    data.data.size = info.size;
+    data.data.data = info.data;
+    release_data->info = info;
+  } else {
+    gst_buffer_map (frame->input_buffer, &info, GST_MAP_READ);
+    data.data.size = info.size;
+    data.data.data = info.data;
+    release_data->info = info;
+    release_data->mapped = frame->input_buffer;
+  }
+
   release_data->frame = gst_video_codec_frame_ref (frame);
 
   cb.unref = gst_droidvenc_release_input_frame;
@@ -606,8 +1270,16 @@ gst_droidvenc_handle_frame (GstVideoEncoder * encoder,
    * to call get_oldest_frame() which acquires the stream lock the base class
    * is holding before calling us
    */
+  gst_droidvenc_update_latency (enc, frame);
+
   GST_VIDEO_ENCODER_STREAM_UNLOCK (encoder);
-  droid_media_codec_queue (enc->codec, &data, &cb);
+#if HAVE_DECL_DROID_MEDIA_CODEC_QUEUE_BUFFER
+  if (buffer) {
+    /* The gralloc buffer goes to the encoder as it is */
+    droid_media_codec_queue_buffer (enc->codec, buffer, &data, &cb);
+  } else
+#endif
+    droid_media_codec_queue (enc->codec, &data, &cb);
   GST_VIDEO_ENCODER_STREAM_LOCK (encoder);
 
   if (enc->downstream_flow_ret != GST_FLOW_OK) {
@@ -638,6 +1310,206 @@ error:
   return ret;
 }
 
+static void
+gst_droidvenc_update_codec (GstDroidVEnc * enc, GstVideoCodecFrame * frame)
+{
+  gint32 bitrate = -1;
+  gint mark_ltr = -1;
+  gint use_ltr = -1;
+
+  GST_OBJECT_LOCK (enc);
+  if (enc->target_bitrate_changed) {
+    bitrate = enc->target_bitrate;
+    enc->target_bitrate_changed = FALSE;
+  }
+
+  if (enc->mark_ltr_pending) {
+    mark_ltr = enc->mark_ltr;
+    enc->mark_ltr_pending = FALSE;
+  }
+
+  if (enc->use_ltr_pending) {
+    use_ltr = enc->use_ltr;
+    enc->use_ltr_pending = FALSE;
+  }
+  GST_OBJECT_UNLOCK (enc);
+
+  if (bitrate != -1) {
+#if HAVE_DECL_DROID_MEDIA_CODEC_SET_BITRATE
+    GST_INFO_OBJECT (enc, "changing bitrate to %d", bitrate);
+    droid_media_codec_set_bitrate (enc->codec, bitrate);
+#else
+    GST_WARNING_OBJECT (enc,
+        "cannot change bitrate of a running codec. %d will be used next time",
+        bitrate);
+#endif
+  }
+
+  /* The base class takes care of upstream and downstream force key unit events
+   * and flags the frame which should become a key frame. */
+  if (GST_VIDEO_CODEC_FRAME_IS_FORCE_KEYFRAME (frame)) {
+#if HAVE_DECL_DROID_MEDIA_CODEC_REQUEST_SYNC_FRAME
+    GST_DEBUG_OBJECT (enc, "requesting sync frame");
+    droid_media_codec_request_sync_frame (enc->codec);
+#else
+    GST_WARNING_OBJECT (enc, "cannot request sync frames from codec");
+#endif
+  }
+
+  if (mark_ltr >= (gint) enc->codec_ltr_count) {
+    GST_WARNING_OBJECT (enc, "cannot mark long term reference %d, "
+        "codec keeps %u", mark_ltr, enc->codec_ltr_count);
+    mark_ltr = -1;
+  }
+
+  if (use_ltr >= (gint) enc->codec_ltr_count) {
+    GST_WARNING_OBJECT (enc, "cannot use long term reference %d, "
+        "codec keeps %u", use_ltr, enc->codec_ltr_count);
+    use_ltr = -1;
+  }
+
+  if (mark_ltr != -1) {
+#if HAVE_DECL_DROID_MEDIA_CODEC_MARK_LTR
+    GST_DEBUG_OBJECT (enc, "marking frame as long term reference %d",
+        mark_ltr);
+    droid_media_codec_mark_ltr (enc->codec, mark_ltr);
+    /* so we can flag the encoded buffer */
+    gst_video_codec_frame_set_user_data (frame, GINT_TO_POINTER (TRUE), NULL);
+#else
+    GST_WARNING_OBJECT (enc, "cannot mark long term reference frames");
+#endif
+  }
+
+  if (use_ltr != -1) {
+#if HAVE_DECL_DROID_MEDIA_CODEC_USE_LTR
+    GST_DEBUG_OBJECT (enc, "using long term reference %d", use_ltr);
+    droid_media_codec_use_ltr (enc->codec, use_ltr);
+#else
+    GST_WARNING_OBJECT (enc, "cannot use long term reference frames");
+#endif
+  }
+
+  gst_droidvenc_update_roi (enc, frame);
+}
+
+static void
+gst_droidvenc_update_latency (GstDroidVEnc * enc, GstVideoCodecFrame * frame)
+{
+  /* Frames the base class handed us and we did not finish yet are the ones
+   * sitting in the codec. The deepest we have seen within the last window of
+   * frames is our latency. Going deeper raises it right away while a whole
+   * window without reaching the old depth lowers it again. */
+  GList *frames = gst_video_encoder_get_frames (GST_VIDEO_ENCODER (enc));
+  guint depth = g_list_length (frames);
+  GstClockTime duration;
+  GstClockTime min, max;
+
+  g_list_free_full (frames, (GDestroyNotify) gst_video_codec_frame_unref);
+
+  enc->window_max_in_flight = MAX (enc->window_max_in_flight, depth);
+
+  if (++enc->window_frames >= GST_DROID_ENC_LATENCY_WINDOW) {
+    depth = enc->window_max_in_flight;
+    enc->window_max_in_flight = 0;
+    enc->window_frames = 0;
+  } else if (depth <= enc->max_in_flight) {
+    return;
+  }
+
+  if (depth == enc->max_in_flight) {
+    return;
+  }
+
+  if (enc->in_state->info.fps_n > 0) {
+    duration = gst_util_uint64_scale_int (GST_SECOND,
+        enc->in_state->info.fps_d, enc->in_state->info.fps_n);
+  } else {
+    duration = frame->duration;
+  }
+
+  if (!GST_CLOCK_TIME_IS_VALID (duration)) {
+    GST_LOG_OBJECT (enc, "unknown frame duration, cannot report latency");
+    return;
+  }
+
+  enc->max_in_flight = depth;
+
+  /* The oldest frame comes out when the newest one goes in at best */
+  min = depth > 0 ? (depth - 1) * duration : 0;
+  max = depth * duration;
+
+  GST_INFO_OBJECT (enc, "%u frames in flight, latency min %" GST_TIME_FORMAT
+      " max %" GST_TIME_FORMAT, depth, GST_TIME_ARGS (min),
+      GST_TIME_ARGS (max));
+
+  /* this also posts a latency message */
+  gst_video_encoder_set_latency (GST_VIDEO_ENCODER (enc), min, max);
+}
+
+static void
+gst_droidvenc_update_roi (GstDroidVEnc * enc, GstVideoCodecFrame * frame)
+{
+  GstMeta *meta;
+  gpointer state = NULL;
+  GArray *rects;
+  gint delta;
+  gint width = enc->in_state->info.width;
+  gint height = enc->in_state->info.height;
+
+  GST_OBJECT_LOCK (enc);
+  delta = enc->roi_qp_delta;
+  GST_OBJECT_UNLOCK (enc);
+
+  rects = g_array_new (FALSE, FALSE, sizeof (DroidMediaRect));
+
+  /* A delta of 0 disables it. Same as no regions */
+  while (delta != 0 && frame->input_buffer
+      && rects->len < GST_DROID_ENC_MAX_ROI
+      && (meta = gst_buffer_iterate_meta (frame->input_buffer, &state))) {
+    GstVideoRegionOfInterestMeta *roi;
+    DroidMediaRect rect;
+
+    if (meta->info->api != GST_VIDEO_REGION_OF_INTEREST_META_API_TYPE) {
+      continue;
+    }
+
+    roi = (GstVideoRegionOfInterestMeta *) meta;
+
+    rect.left = MIN (roi->x, width);
+    rect.top = MIN (roi->y, height);
+    rect.right = MIN (roi->x + roi->w, width);
+    rect.bottom = MIN (roi->y + roi->h, height);
+
+    if (rect.right > rect.left && rect.bottom > rect.top) {
+      g_array_append_val (rects, rect);
+    }
+  }
+
+  /* Regions tend to stay the same for many frames. Don't bother the codec. */
+  if (rects->len == enc->roi->len && (rects->len == 0
+          || !memcmp (rects->data, enc->roi->data,
+              rects->len * sizeof (DroidMediaRect)))) {
+    g_array_free (rects, TRUE);
+    return;
+  }
+
+  GST_DEBUG_OBJECT (enc, "%u regions of interest with qp delta %d",
+      rects->len, delta);
+
+#if HAVE_DECL_DROID_MEDIA_CODEC_SET_ROI
+  droid_media_codec_set_roi (enc->codec, (DroidMediaRect *) rects->data,
+      rects->len, delta);
+#else
+  if (!enc->roi_warned) {
+    GST_WARNING_OBJECT (enc, "region of interest encoding is not supported");
+    enc->roi_warned = TRUE;
+  }
+#endif
+
+  g_array_free (enc->roi, TRUE);
+  enc->roi = rects;
+}
+
 static gboolean
 gst_droidvenc_flush (GstVideoEncoder * encoder)
 {
@@ -664,8 +1536,34 @@ gst_droidvenc_init (GstDroidVEnc * enc)
   enc->codec_type = NULL;
   enc->in_state = NULL;
   enc->out_state = NULL;
+  enc->pool = NULL;
+  enc->upload_pool = NULL;
   enc->target_bitrate = GST_DROID_ENC_TARGET_BITRATE_DEFAULT;
+  enc->target_bitrate_changed = FALSE;
+  enc->rate_control = GST_DROID_ENC_RATE_CONTROL_DEFAULT;
+  enc->i_frame_interval = GST_DROID_ENC_I_FRAME_INTERVAL_DEFAULT;
+  enc->b_frames = GST_DROID_ENC_B_FRAMES_DEFAULT;
+  enc->min_qp = GST_DROID_ENC_QP_DEFAULT;
+  enc->max_qp = GST_DROID_ENC_QP_DEFAULT;
+  enc->slices = GST_DROID_ENC_SLICES_PER_FRAME_DEFAULT;
+  enc->nal_aligned = FALSE;
+  enc->in_frame = FALSE;
+  enc->temporal_layers = GST_DROID_ENC_TEMPORAL_LAYERS_DEFAULT;
+  enc->ltr_count = GST_DROID_ENC_LTR_COUNT_DEFAULT;
+  enc->codec_temporal_layers = GST_DROID_ENC_TEMPORAL_LAYERS_DEFAULT;
+  enc->codec_ltr_count = GST_DROID_ENC_LTR_COUNT_DEFAULT;
+  enc->mark_ltr = -1;
+  enc->mark_ltr_pending = FALSE;
+  enc->use_ltr = -1;
+  enc->use_ltr_pending = FALSE;
+  enc->roi_qp_delta = GST_DROID_ENC_ROI_QP_DELTA_DEFAULT;
+  enc->roi = g_array_new (FALSE, FALSE, sizeof (DroidMediaRect));
+  enc->roi_warned = FALSE;
+  enc->frames_since_sync = 0;
   enc->downstream_flow_ret = GST_FLOW_OK;
+  enc->max_in_flight = 0;
+  enc->window_max_in_flight = 0;
+  enc->window_frames = 0;
   g_mutex_init (&enc->eos_lock);
   g_cond_init (&enc->eos_cond);
 }
@@ -772,5 +1670,78 @@ gst_droidvenc_class_init (GstDroidVEncClass * klass)
       g_param_spec_int ("target-bitrate", "Target Bitrate",
           "Target bitrate", 0, G_MAXINT,
           GST_DROID_ENC_TARGET_BITRATE_DEFAULT,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_PLAYING));
+
+  g_object_class_install_property (gobject_class, PROP_RATE_CONTROL,
+      g_param_spec_enum ("rate-control", "Rate control",
+          "Rate control mode", GST_TYPE_DROIDVENC_RATE_CONTROL,
+          GST_DROID_ENC_RATE_CONTROL_DEFAULT,
           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_I_FRAME_INTERVAL,
+      g_param_spec_int ("i-frame-interval", "I-frame interval",
+          "Seconds between I-frames (0 = all I-frames, -1 = only the first one)",
+          -1, G_MAXINT, GST_DROID_ENC_I_FRAME_INTERVAL_DEFAULT,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_B_FRAMES,
+      g_param_spec_uint ("b-frames", "B-frames",
+          "Number of B-frames between I and P frames", 0, 16,
+          GST_DROID_ENC_B_FRAMES_DEFAULT,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_MIN_QP,
+      g_param_spec_int ("min-qp", "Minimum QP",
+          "Minimum quantizer (-1 = codec default)", -1, 51,
+          GST_DROID_ENC_QP_DEFAULT,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_MAX_QP,
+      g_param_spec_int ("max-qp", "Maximum QP",
+          "Maximum quantizer (-1 = codec default)", -1, 51,
+          GST_DROID_ENC_QP_DEFAULT,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_SLICES_PER_FRAME,
+      g_param_spec_uint ("slices-per-frame", "Slices per frame",
+          "Number of slices per frame (0 = codec default)", 0, 256,
+          GST_DROID_ENC_SLICES_PER_FRAME_DEFAULT,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_TEMPORAL_LAYERS,
+      g_param_spec_uint ("temporal-layers", "Temporal layers",
+          "Number of temporal layers (1 = no temporal scalability)", 1, 4,
+          GST_DROID_ENC_TEMPORAL_LAYERS_DEFAULT,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_LTR_COUNT,
+      g_param_spec_uint ("ltr-count", "LTR count",
+          "Number of long term reference frames the encoder keeps",
+          0, GST_DROID_ENC_MAX_LTR_COUNT, GST_DROID_ENC_LTR_COUNT_DEFAULT,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_MARK_LTR,
+      g_param_spec_int ("mark-ltr", "Mark LTR",
+          "Store the next frame as long term reference with this index "
+          "(must be below ltr-count)",
+          -1, GST_DROID_ENC_MAX_LTR_COUNT - 1, -1,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_PLAYING));
+
+  g_object_class_install_property (gobject_class, PROP_USE_LTR,
+      g_param_spec_int ("use-ltr", "Use LTR",
+          "Predict the next frame from the long term reference with this "
+          "index (must be below ltr-count)",
+          -1, GST_DROID_ENC_MAX_LTR_COUNT - 1, -1,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_PLAYING));
+
+  g_object_class_install_property (gobject_class, PROP_ROI_QP_DELTA,
+      g_param_spec_int ("roi-qp-delta", "ROI QP delta",
+          "Quantizer offset for regions of interest from "
+          "GstVideoRegionOfInterestMeta (0 = ignore regions)", -51, 51,
+          GST_DROID_ENC_ROI_QP_DELTA_DEFAULT,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_PLAYING));
 }
@@ -38,9 +38,20 @@ G_BEGIN_DECLS
 #define GST_IS_DROIDVENC_CLASS(klass) \
   (G_TYPE_CHECK_CLASS_TYPE((klass), GST_TYPE_DROIDVENC))
 
+#define GST_TYPE_DROIDVENC_RATE_CONTROL (gst_droidvenc_rate_control_get_type())
+
 typedef struct _GstDroidVEnc GstDroidVEnc;
 typedef struct _GstDroidVEncClass GstDroidVEncClass;
 
+/* Values match android MediaCodecInfo.EncoderCapabilities BITRATE_MODE_* */
+typedef enum
+{
+  GST_DROIDVENC_RATE_CONTROL_DEFAULT = -1,
+  GST_DROIDVENC_RATE_CONTROL_CQ = 0,
+  GST_DROIDVENC_RATE_CONTROL_VBR = 1,
+  GST_DROIDVENC_RATE_CONTROL_CBR = 2,
+} GstDroidVEncRateControl;
+
 struct _GstDroidVEnc
 {
   GstVideoEncoder parent;
@@ -49,7 +60,52 @@ struct _GstDroidVEnc
   GstVideoCodecState *in_state;
   GstVideoCodecState *out_state;
   gboolean first_frame_sent;
+  gboolean use_hardware_buffers;
+  gboolean use_system_memory;
+  GstBufferPool *upload_pool;
+  GstVideoFormat upload_format;
+  gsize upload_stride;
+  gsize upload_slice_height;
+  GstDroidBucketPool *pool;
+
+  /* protected by object lock */
   gint32 target_bitrate;
+  gboolean target_bitrate_changed;
+  gint mark_ltr;
+  gboolean mark_ltr_pending;
+  gint use_ltr;
+  gboolean use_ltr_pending;
+  gint roi_qp_delta;
+
+  /* used when creating the codec */
+  GstDroidVEncRateControl rate_control;
+  gint i_frame_interval;
+  guint b_frames;
+  gint min_qp;
+  gint max_qp;
+  guint slices;
+  guint temporal_layers;
+  guint ltr_count;
+
+  /* what the codec was really configured with. protected by encoder stream lock */
+  guint codec_temporal_layers;
+  guint codec_ltr_count;
+
+  /* alignment=nal output. protected by encoder stream lock */
+  gboolean nal_aligned;
+  gboolean in_frame;
+  GstClockTime frame_pts;
+  GstClockTime frame_dts;
+  gboolean frame_sync;
+  guint frame_layer_id;
+  gboolean frame_ltr;
+
+  /* temporal layers. protected by encoder stream lock */
+  guint frames_since_sync;
+
+  /* regions of interest last given to the codec. protected by encoder stream lock */
+  GArray *roi;
+  gboolean roi_warned;
 
   /* eos handling */
   gboolean eos;
@@ -59,6 +115,9 @@ struct _GstDroidVEnc
   /* protected by decoder stream lock */
   GstFlowReturn downstream_flow_ret;
   gboolean dirty;
+  guint max_in_flight;
+  guint window_max_in_flight;
+  guint window_frames;
 };
 
 struct _GstDroidVEncClass
@@ -67,6 +126,7 @@ struct _GstDroidVEncClass
 };
 
 GType gst_droidvenc_get_type (void);
+GType gst_droidvenc_rate_control_get_type (void);
 
 G_END_DECLS
 
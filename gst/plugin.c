@@ -31,6 +31,7 @@
 #include "gstdroidvenc.h"
 #include "gstdroidadec.h"
 #include "gstdroidaenc.h"
+#include "gstdroidsimulcastenc.h"
 #include "droidmedia.h"
 
 GST_DEBUG_CATEGORY (gst_droid_camsrc_debug);
@@ -38,6 +39,7 @@ GST_DEBUG_CATEGORY (gst_droid_adec_debug);
 GST_DEBUG_CATEGORY (gst_droid_aenc_debug);
 GST_DEBUG_CATEGORY (gst_droid_vdec_debug);
 GST_DEBUG_CATEGORY (gst_droid_venc_debug);
+GST_DEBUG_CATEGORY (gst_droid_simulcastenc_debug);
 GST_DEBUG_CATEGORY (gst_droid_codec_debug);
 GST_DEBUG_CATEGORY (gst_droid_eglsink_debug);
 GST_DEBUG_CATEGORY (gst_droid_videotexturesink_debug);
@@ -68,6 +70,9 @@ plugin_init (GstPlugin * plugin)
   GST_DEBUG_CATEGORY_INIT (gst_droid_venc_debug, "droidvenc",
       0, "Android HAL video encoder");
 
+  GST_DEBUG_CATEGORY_INIT (gst_droid_simulcastenc_debug, "droidsimulcastenc",
+      0, "Android HAL simulcast video encoder");
+
   GST_DEBUG_CATEGORY_INIT (gst_droid_codec_debug, "droidcodec",
       0, "Android HAL codec");
 
@@ -86,6 +91,8 @@ plugin_init (GstPlugin * plugin)
       GST_TYPE_DROIDADEC);
   ok &= gst_element_register (plugin, "droidaenc", GST_RANK_PRIMARY + 1,
       GST_TYPE_DROIDAENC);
+  ok &= gst_element_register (plugin, "droidsimulcastenc", GST_RANK_NONE,
+      GST_TYPE_DROIDSIMULCASTENC);
 
   if (ok)
     droid_media_init ();
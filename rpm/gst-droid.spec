@@ -76,3 +76,4 @@ rm -rf $RPM_BUILD_ROOT%{_sysconfdir}/gst-droid
 %{_bindir}/mk-cam-conf
 %{_bindir}/record-video
 %{_bindir}/dump-resolutions
+%{_bindir}/bench-transcode
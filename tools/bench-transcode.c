@@ -0,0 +1,459 @@
+/*
+ * gst-droid
+ *
+ * Copyright (C) 2015 Jolla LTD.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/*
+ * Decodes a file with droidvdec, encodes it again with droidvenc and throws
+ * the result away. Prints throughput, per stage latency, CPU time and peak
+ * memory as JSON.
+ */
+
+#include <gst/gst.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include "common.h"
+
+/* from gst-plugins-base playback plugin */
+typedef enum
+{
+  AUTOPLUG_SELECT_TRY,
+  AUTOPLUG_SELECT_EXPOSE,
+  AUTOPLUG_SELECT_SKIP
+} AutoplugSelectResult;
+
+typedef enum
+{
+  STAGE_DECODER,
+  STAGE_ENCODER,
+  STAGE_TOTAL,
+  STAGE_LAST
+} Stage;
+
+static const gchar *stage_names[STAGE_LAST] = { "decoder", "encoder", "total" };
+
+typedef struct
+{
+  /* pts -> monotonic time the buffer entered the stage */
+  GHashTable *in;
+  GArray *samples;
+} StageStats;
+
+typedef struct
+{
+  GMutex lock;
+  StageStats stages[STAGE_LAST];
+  guint frames;
+  gint64 first_frame;
+  gint64 last_frame;
+} Bench;
+
+static gchar *input = NULL;
+static gchar *codec = "h264";
+static gchar *memory = "system";
+static gchar *output = NULL;
+static gint width = 0;
+static gint height = 0;
+static gint bitrate = 0;
+
+static GOptionEntry entries[] = {
+  {"input", 'i', 0, G_OPTION_ARG_FILENAME, &input, "File to transcode", NULL},
+  {"codec", 'c', 0, G_OPTION_ARG_STRING, &codec,
+      "Output codec: h264 or mpeg4 (default h264)", NULL},
+  {"memory", 'm', 0, G_OPTION_ARG_STRING, &memory,
+        "Decoder output memory: system or queue-buffer (default system)",
+      NULL},
+  {"width", 'W', 0, G_OPTION_ARG_INT, &width,
+      "Output width (system memory only)", NULL},
+  {"height", 'H', 0, G_OPTION_ARG_INT, &height,
+      "Output height (system memory only)", NULL},
+  {"bitrate", 'b', 0, G_OPTION_ARG_INT, &bitrate, "Encoder bitrate", NULL},
+  {"output", 'o', 0, G_OPTION_ARG_FILENAME, &output,
+      "Write JSON results here instead of stdout", NULL},
+  {NULL}
+};
+
+static const gchar *
+codec_caps (const gchar * name)
+{
+  if (!g_strcmp0 (name, "h264")) {
+    return "video/x-h264";
+  } else if (!g_strcmp0 (name, "mpeg4")) {
+    return "video/mpeg, mpegversion=(int)4";
+  }
+
+  return NULL;
+}
+
+static GstPadProbeReturn
+stage_in_probe (GstPad * pad, GstPadProbeInfo * info, gpointer user_data)
+{
+  Bench *bench = g_object_get_data (G_OBJECT (pad), "bench");
+  Stage stage = GPOINTER_TO_INT (user_data);
+  GstClockTime pts = GST_BUFFER_PTS (GST_PAD_PROBE_INFO_BUFFER (info));
+  GstClockTime *key;
+  gint64 *now;
+
+  if (!GST_CLOCK_TIME_IS_VALID (pts)) {
+    return GST_PAD_PROBE_OK;
+  }
+
+  key = g_new (GstClockTime, 1);
+  *key = pts;
+
+  now = g_new (gint64, 1);
+  *now = g_get_monotonic_time ();
+
+  g_mutex_lock (&bench->lock);
+  g_hash_table_insert (bench->stages[stage].in, key, now);
+  g_mutex_unlock (&bench->lock);
+
+  return GST_PAD_PROBE_OK;
+}
+
+static GstPadProbeReturn
+stage_out_probe (GstPad * pad, GstPadProbeInfo * info, gpointer user_data)
+{
+  Bench *bench = g_object_get_data (G_OBJECT (pad), "bench");
+  Stage stage = GPOINTER_TO_INT (user_data);
+  GstClockTime pts = GST_BUFFER_PTS (GST_PAD_PROBE_INFO_BUFFER (info));
+  gint64 now = g_get_monotonic_time ();
+  gint64 *then;
+
+  if (!GST_CLOCK_TIME_IS_VALID (pts)) {
+    return GST_PAD_PROBE_OK;
+  }
+
+  g_mutex_lock (&bench->lock);
+
+  then = g_hash_table_lookup (bench->stages[stage].in, &pts);
+  if (then) {
+    gint64 latency = now - *then;
+    g_array_append_val (bench->stages[stage].samples, latency);
+    g_hash_table_remove (bench->stages[stage].in, &pts);
+  }
+
+  /* the encoder output is the end of the pipeline for us */
+  if (stage == STAGE_ENCODER) {
+    then = g_hash_table_lookup (bench->stages[STAGE_TOTAL].in, &pts);
+    if (then) {
+      gint64 latency = now - *then;
+      g_array_append_val (bench->stages[STAGE_TOTAL].samples, latency);
+      g_hash_table_remove (bench->stages[STAGE_TOTAL].in, &pts);
+    }
+
+    if (bench->frames == 0) {
+      bench->first_frame = now;
+    }
+
+    bench->last_frame = now;
+    ++bench->frames;
+  }
+
+  g_mutex_unlock (&bench->lock);
+
+  return GST_PAD_PROBE_OK;
+}
+
+static void
+add_probe (Bench * bench, GstElement * elem, const gchar * pad_name,
+    GstPadProbeCallback cb, Stage stage)
+{
+  GstPad *pad = gst_element_get_static_pad (elem, pad_name);
+
+  g_object_set_data (G_OBJECT (pad), "bench", bench);
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER, cb,
+      GINT_TO_POINTER (stage), NULL);
+  gst_object_unref (pad);
+}
+
+static AutoplugSelectResult
+autoplug_select (GstElement * bin, GstPad * pad, GstCaps * caps,
+    GstElementFactory * factory, gpointer user_data)
+{
+  const gchar *klass =
+      gst_element_factory_get_metadata (factory, GST_ELEMENT_METADATA_KLASS);
+
+  /* we are benchmarking droidvdec and nothing else */
+  if (strstr (klass, "Decoder") && strstr (klass, "Video")
+      && g_strcmp0 (GST_OBJECT_NAME (factory), "droidvdec")) {
+    return AUTOPLUG_SELECT_SKIP;
+  }
+
+  return AUTOPLUG_SELECT_TRY;
+}
+
+static void
+element_added (GstBin * bin, GstElement * elem, Bench * bench)
+{
+  GstElementFactory *factory = gst_element_get_factory (elem);
+
+  if (factory && !g_strcmp0 (GST_OBJECT_NAME (factory), "droidvdec")) {
+    add_probe (bench, elem, "sink", stage_in_probe, STAGE_DECODER);
+    add_probe (bench, elem, "sink", stage_in_probe, STAGE_TOTAL);
+    add_probe (bench, elem, "src", stage_out_probe, STAGE_DECODER);
+  }
+}
+
+static gint
+compare_samples (gconstpointer a, gconstpointer b)
+{
+  gint64 x = *(const gint64 *) a;
+  gint64 y = *(const gint64 *) b;
+
+  return x < y ? -1 : x > y ? 1 : 0;
+}
+
+static gdouble
+percentile (GArray * samples, gdouble p)
+{
+  guint index;
+
+  if (samples->len == 0) {
+    return 0;
+  }
+
+  index = (guint) (p * samples->len + 0.5);
+  index = CLAMP (index, 1, samples->len) - 1;
+
+  /* ms */
+  return g_array_index (samples, gint64, index) / 1000.0;
+}
+
+static gchar *
+json_string (const gchar * str)
+{
+  GString *out = g_string_new ("\"");
+  const gchar *c;
+
+  for (c = str; c && *c; c++) {
+    if (*c == '"' || *c == '\\') {
+      g_string_append_c (out, '\\');
+      g_string_append_c (out, *c);
+    } else if ((guchar) * c < 0x20) {
+      g_string_append_printf (out, "\\u%04x", *c);
+    } else {
+      g_string_append_c (out, *c);
+    }
+  }
+
+  g_string_append_c (out, '"');
+
+  return g_string_free (out, FALSE);
+}
+
+static gchar *
+report (Bench * bench, const gchar * pipeline, int ret, struct rusage *start,
+    struct rusage *end, gint64 wall)
+{
+  GString *json = g_string_new ("{\n");
+  gchar *str;
+  gdouble user, sys, seconds, fps;
+  gint i;
+
+  user = (end->ru_utime.tv_sec - start->ru_utime.tv_sec) +
+      (end->ru_utime.tv_usec - start->ru_utime.tv_usec) / 1000000.0;
+  sys = (end->ru_stime.tv_sec - start->ru_stime.tv_sec) +
+      (end->ru_stime.tv_usec - start->ru_stime.tv_usec) / 1000000.0;
+  seconds = wall / 1000000.0;
+  fps = bench->frames > 1 ?
+      (bench->frames - 1) * 1000000.0 / (bench->last_frame -
+      bench->first_frame) : 0;
+
+  str = json_string (input);
+  g_string_append_printf (json, "  \"input\": %s,\n", str);
+  g_free (str);
+
+  str = json_string (pipeline);
+  g_string_append_printf (json, "  \"pipeline\": %s,\n", str);
+  g_free (str);
+
+  g_string_append_printf (json, "  \"codec\": \"%s\",\n", codec);
+  g_string_append_printf (json, "  \"memory\": \"%s\",\n", memory);
+  g_string_append_printf (json, "  \"width\": %d,\n", width);
+  g_string_append_printf (json, "  \"height\": %d,\n", height);
+  g_string_append_printf (json, "  \"bitrate\": %d,\n", bitrate);
+  g_string_append_printf (json, "  \"success\": %s,\n",
+      ret == 0 ? "true" : "false");
+  g_string_append_printf (json, "  \"frames\": %u,\n", bench->frames);
+  g_string_append_printf (json, "  \"wall_time_s\": %.3f,\n", seconds);
+  g_string_append_printf (json, "  \"fps\": %.2f,\n", fps);
+  g_string_append_printf (json, "  \"cpu_user_s\": %.3f,\n", user);
+  g_string_append_printf (json, "  \"cpu_system_s\": %.3f,\n", sys);
+  g_string_append_printf (json, "  \"cpu_percent\": %.1f,\n",
+      seconds > 0 ? (user + sys) * 100 / seconds : 0);
+  /* ru_maxrss is in KiB on Linux */
+  g_string_append_printf (json, "  \"peak_rss_kb\": %ld,\n", end->ru_maxrss);
+  g_string_append (json, "  \"latency_ms\": {\n");
+
+  for (i = 0; i < STAGE_LAST; i++) {
+    GArray *samples = bench->stages[i].samples;
+
+    g_array_sort (samples, compare_samples);
+
+    g_string_append_printf (json,
+        "    \"%s\": { \"samples\": %u, \"p50\": %.2f, \"p90\": %.2f, "
+        "\"p99\": %.2f, \"max\": %.2f }%s\n", stage_names[i], samples->len,
+        percentile (samples, 0.5), percentile (samples, 0.9),
+        percentile (samples, 0.99), percentile (samples, 1.0),
+        i == STAGE_LAST - 1 ? "" : ",");
+  }
+
+  g_string_append (json, "  }\n}\n");
+
+  return g_string_free (json, FALSE);
+}
+
+int
+main (int argc, char *argv[])
+{
+  GOptionContext *ctx;
+  GError *err = NULL;
+  Common *common;
+  Bench bench;
+  GString *desc;
+  GstElement *elem;
+  struct rusage start, end;
+  gint64 wall;
+  gchar *json;
+  gchar *pipeline;
+  const gchar *caps;
+  int ret;
+  gint i;
+
+  ctx = g_option_context_new ("- droid codec transcode benchmark");
+  g_option_context_add_main_entries (ctx, entries, NULL);
+  g_option_context_add_group (ctx, gst_init_get_option_group ());
+  if (!g_option_context_parse (ctx, &argc, &argv, &err)) {
+    g_print ("%s\n", err->message);
+    g_error_free (err);
+    g_option_context_free (ctx);
+    return 1;
+  }
+
+  g_option_context_free (ctx);
+
+  if (!input) {
+    g_print ("--input is required\n");
+    return 1;
+  }
+
+  caps = codec_caps (codec);
+  if (!caps) {
+    g_print ("unknown codec %s\n", codec);
+    return 1;
+  }
+
+  desc = g_string_new (NULL);
+  g_string_append_printf (desc, "filesrc location=\"%s\" ! decodebin name=dec",
+      input);
+
+  if (!g_strcmp0 (memory, "system")) {
+    g_string_append (desc, " ! video/x-raw, format=I420");
+    if (width > 0 && height > 0) {
+      g_string_append_printf (desc,
+          " ! videoscale ! video/x-raw, width=%d, height=%d", width, height);
+    }
+  } else if (!g_strcmp0 (memory, "queue-buffer")) {
+    if (width > 0 || height > 0) {
+      g_print ("scaling is only possible with system memory\n");
+      g_string_free (desc, TRUE);
+      return 1;
+    }
+
+    g_string_append (desc, " ! video/x-raw(memory:DroidMediaQueueBuffer)");
+  } else {
+    g_print ("unknown memory mode %s\n", memory);
+    g_string_free (desc, TRUE);
+    return 1;
+  }
+
+  g_string_append (desc, " ! droidvenc name=enc");
+  if (bitrate > 0) {
+    g_string_append_printf (desc, " target-bitrate=%d", bitrate);
+  }
+
+  g_string_append_printf (desc, " ! %s ! fakesink sync=false", caps);
+
+  pipeline = g_string_free (desc, FALSE);
+
+  common = common_init_pipeline (&argc, &argv, pipeline);
+  if (!common) {
+    g_free (pipeline);
+    return 1;
+  }
+
+  memset (&bench, 0x0, sizeof (bench));
+  g_mutex_init (&bench.lock);
+  for (i = 0; i < STAGE_LAST; i++) {
+    bench.stages[i].in =
+        g_hash_table_new_full (g_int64_hash, g_int64_equal, g_free, g_free);
+    bench.stages[i].samples = g_array_new (FALSE, FALSE, sizeof (gint64));
+  }
+
+  elem = gst_bin_get_by_name (GST_BIN (common->bin), "dec");
+  g_signal_connect (elem, "autoplug-select", G_CALLBACK (autoplug_select),
+      NULL);
+  g_signal_connect (elem, "element-added", G_CALLBACK (element_added), &bench);
+  gst_object_unref (elem);
+
+  elem = gst_bin_get_by_name (GST_BIN (common->bin), "enc");
+  add_probe (&bench, elem, "sink", stage_in_probe, STAGE_ENCODER);
+  add_probe (&bench, elem, "src", stage_out_probe, STAGE_ENCODER);
+  gst_object_unref (elem);
+
+  getrusage (RUSAGE_SELF, &start);
+  wall = g_get_monotonic_time ();
+
+  if (!common_run (common)) {
+    common->ret = 1;
+  }
+
+  wall = g_get_monotonic_time () - wall;
+  getrusage (RUSAGE_SELF, &end);
+
+  ret = common->ret;
+
+  json = report (&bench, pipeline, ret, &start, &end, wall);
+
+  if (output) {
+    if (!g_file_set_contents (output, json, -1, &err)) {
+      g_print ("failed to write %s: %s\n", output, err->message);
+      g_error_free (err);
+      ret = 1;
+    }
+  } else {
+    g_print ("%s", json);
+  }
+
+  g_free (json);
+  g_free (pipeline);
+
+  for (i = 0; i < STAGE_LAST; i++) {
+    g_hash_table_destroy (bench.stages[i].in);
+    g_array_free (bench.stages[i].samples, TRUE);
+  }
+
+  g_mutex_clear (&bench.lock);
+
+  common_destroy (common, TRUE);
+
+  return ret;
+}
@@ -55,6 +55,10 @@ bus_watch (GstBus * bus, GstMessage * message, gpointer user_data)
     }
       break;
 
+    case GST_MESSAGE_EOS:
+      common_quit (c, 0);
+      break;
+
     case GST_MESSAGE_STATE_CHANGED:{
       GstState oldState, newState, pending;
       if (GST_ELEMENT (GST_MESSAGE_SRC (message)) != c->bin) {
@@ -173,6 +177,43 @@ out:
   return common;
 }
 
+Common *
+common_init_pipeline (int *argc, char ***argv, const gchar * description)
+{
+  Common *common = NULL;
+  GstBus *bus = NULL;
+  GError *err = NULL;
+
+  common = g_malloc0 (sizeof (Common));
+  common->loop = g_main_loop_new (NULL, FALSE);
+
+  gst_init (argc, argv);
+
+  common->bin = gst_parse_launch (description, &err);
+  if (!common->bin) {
+    g_print ("Failed to create pipeline %s: %s\n", description,
+        err ? err->message : "unknown error");
+    g_clear_error (&err);
+    goto error;
+  }
+
+  if (err) {
+    g_print ("warning: %s\n", err->message);
+    g_clear_error (&err);
+  }
+
+  bus = gst_pipeline_get_bus (GST_PIPELINE (common->bin));
+  gst_bus_add_watch (bus, bus_watch, common);
+  gst_object_unref (bus);
+  bus = NULL;
+
+  return common;
+
+error:
+  common_destroy (common, TRUE);
+  return NULL;
+}
+
 int
 common_destroy (Common * common, gboolean deinit)
 {
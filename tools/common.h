@@ -52,6 +52,7 @@ typedef enum {
 } Mode;
 
 Common *common_init (int *argc, char ***argv, char *bin);
+Common *common_init_pipeline (int *argc, char ***argv, const gchar *description);
 int common_destroy (Common *common, gboolean deinit);
 gboolean common_run (Common *c);
 